@@ -0,0 +1,102 @@
+#include "xProject_pch.hpp"
+
+#include <cstdio>
+
+#include "network/JsonCodec.hpp"
+#include "utils/Timer.hpp"
+
+/// Text vs binary JSON through an IBody, built on its own (excluded from the library
+/// build). The binary formats save about a third of the bytes, with nlohmann's encoders
+/// they are not faster than dump()/parse(): there is no CPU gain, only a wire one.
+
+namespace Net {
+
+	struct JsonCodecTiming {
+		// Averages per call
+		std::chrono::nanoseconds encode{};
+		std::chrono::nanoseconds decode{};
+		std::size_t bytes = 0;
+	};
+
+	struct JsonCodecBenchmark {
+		JsonCodecTiming text;
+		JsonCodecTiming msgpack;
+		JsonCodecTiming cbor;
+	};
+
+	/// Encodes and decodes _sample _iterations times through an IBody, as text with
+	/// dump()/parse() and with JsonCodec in both formats. Meant for sizing payloads of
+	/// the application, the numbers depend entirely on the shape of _sample.
+	JsonCodecBenchmark BenchmarkJsonCodec(const JSON& _sample, std::size_t _iterations = 10000) {
+		_iterations = std::max<std::size_t>(_iterations, 1);
+
+		IBody body;
+		JSON decoded;
+		JsonCodecBenchmark result;
+
+		auto measure = [&](JsonCodecTiming& _timing, auto&& _encode, auto&& _decode) {
+			Utils::Timer timer;
+			for (std::size_t i = 0; i < _iterations; i++) {
+				_encode();
+			}
+			_timing.encode = timer.Restart() / _iterations;
+			_timing.bytes = body.Size();
+
+			for (std::size_t i = 0; i < _iterations; i++) {
+				_decode();
+			}
+			_timing.decode = timer.Restart() / _iterations;
+		};
+
+		measure(result.text,
+			[&]() {
+				const std::string text = _sample.dump();
+				body.Data().assign(text.begin(), text.end());
+			},
+			[&]() {
+				decoded = JSON::parse(body.Data().begin(), body.Data().begin() + body.Size(), nullptr, false);
+			}
+		);
+
+		for (JsonFormat format : { JsonFormat::MessagePack, JsonFormat::CBOR }) {
+			measure(format == JsonFormat::MessagePack ? result.msgpack : result.cbor,
+				[&]() { JsonCodec::Encode(body, _sample, format); },
+				[&]() { JsonCodec::Decode(body, decoded, format); }
+			);
+		}
+		return result;
+	}
+
+}
+
+namespace {
+
+	void Print(const char* _name, const Net::JsonCodecTiming& _timing) {
+		std::printf("  %-8s %6zu B  encode %8lld ns  decode %8lld ns\n", _name, _timing.bytes,
+			static_cast<long long>(_timing.encode.count()), static_cast<long long>(_timing.decode.count()));
+	}
+
+	void Run(const char* _title, const JSON& _sample, std::size_t _iterations) {
+		const Net::JsonCodecBenchmark result = Net::BenchmarkJsonCodec(_sample, _iterations);
+
+		std::printf("%s:\n", _title);
+		Print("text", result.text);
+		Print("msgpack", result.msgpack);
+		Print("cbor", result.cbor);
+	}
+
+}
+
+int main()
+{
+	const JSON small = { {"type", "login"}, {"id", 42}, {"ok", true}, {"ratio", 0.5} };
+
+	JSON large;
+	for (int i = 0; i < 200; i++) {
+		large["items"].push_back({ {"name", "item" + std::to_string(i)}, {"size", i * 1024}, {"mtime", 1700000000 + i}, {"tags", { "a", "b" }} });
+	}
+
+	Run("4-field object", small, 200000);
+	Run("200-entry array", large, 2000);
+	return 0;
+}
\ No newline at end of file
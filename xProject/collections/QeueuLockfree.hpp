@@ -1,7 +1,9 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 namespace Utils
 {
@@ -30,9 +32,14 @@ namespace Utils
 		std::atomic<Node<TypeVal>*> head;
 		std::atomic<Node<TypeVal>*> tail;
 		std::atomic_bool stopWait = false;
+		// Approximate while pushes and pops are in flight, a pop may count before its push
+		std::atomic<std::ptrdiff_t> count = 0;
 
 		std::mutex m_blockingQueue;
 		std::condition_variable m_cvQueue;
+		// Consumers take turns: a pop moves the value out before its CAS and frees the old head
+		// right after it, both unsafe against a second consumer. Producers stay lock-free.
+		std::mutex m_popQueue;
 	public:
 		QueueLF()
 		{
@@ -59,12 +66,13 @@ namespace Utils
 		inline void push_back(const TypeVal& _val)
 		{
 			Node<TypeVal>* newTail = new Node<TypeVal>(std::move(_val));
-			Node<TypeVal>* expected = nullptr;
 			while (true)
 			{
+				Node<TypeVal>* expected = nullptr;
 				Node<TypeVal>* curTail = tail.load(std::memory_order_acquire);
 				if (curTail->next.compare_exchange_strong(expected, newTail))
 				{
+					count.fetch_add(1, std::memory_order_relaxed);
 					if (tail.compare_exchange_strong(curTail, newTail))
 					{
 						m_cvQueue.notify_one();
@@ -84,12 +92,13 @@ namespace Utils
 		inline void push_back(TypeVal&& _val)
 		{
 			Node<TypeVal>* newTail = new Node<TypeVal>(std::forward<TypeVal>(_val));
-			Node<TypeVal>* expected = nullptr;
 			while (true)
 			{
+				Node<TypeVal>* expected = nullptr;
 				Node<TypeVal>* curTail = tail.load(std::memory_order_acquire);
 				if (curTail->next.compare_exchange_strong(expected, newTail))
 				{
+					count.fetch_add(1, std::memory_order_relaxed);
 					if (tail.compare_exchange_strong(curTail, newTail))
 					{
 						m_cvQueue.notify_one();
@@ -106,8 +115,11 @@ namespace Utils
 			}
 		}
 
+		// One uncontended lock per pop (a few ns on the single consumer paths), several consumers
+		// of one queue, as in a ThreadPool, pop one after another
 		inline TypeVal pop_front()
 		{
+			std::lock_guard<std::mutex> lock(m_popQueue);
 			while (true)
 			{
 				Node<TypeVal>* curHead = head.load(std::memory_order_acquire);
@@ -121,11 +133,8 @@ namespace Utils
 					}
 					else
 					{
+						// tail is lagging behind a finished push, help it forward; head still owns curHead
 						tail.compare_exchange_strong(curTail, nextHead);
-						if (curHead != nullptr)
-						{
-							delete curHead;
-						}
 					}
 				}
 				else
@@ -133,6 +142,7 @@ namespace Utils
 					TypeVal result = std::move(nextHead->value);
 					if (head.compare_exchange_strong(curHead, nextHead))
 					{
+						count.fetch_sub(1, std::memory_order_relaxed);
 						if (curHead != nullptr)
 						{
 							delete curHead;
@@ -148,6 +158,12 @@ namespace Utils
 			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
 		}
 
+		inline std::size_t size() const
+		{
+			const std::ptrdiff_t current = count.load(std::memory_order_relaxed);
+			return current > 0 ? static_cast<std::size_t>(current) : 0;
+		}
+
 		inline void clear()
 		{
 			while (!empty())
@@ -0,0 +1,506 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#if !defined(BOOST_ASIO_HAS_FILE)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "PathStruct.hpp"
+#include "utils/Coroutine.hpp"
+#include "utils/ThreadPool.hpp"
+
+namespace FileS
+{
+
+	namespace asio = boost::asio;
+
+	enum class AsyncOpenMode
+	{
+		Read,
+		// Creates or truncates
+		Write,
+		// Creates if missing, keeps the contents
+		ReadWrite
+	};
+
+	struct IoResult
+	{
+		boost::system::error_code error;
+		// Less than requested only on error or when a read hit the end of the file
+		std::size_t transferred = 0;
+	};
+
+	/// One operation of a batch, the buffer must stay valid until the batch completes
+	struct IoRequest
+	{
+		enum class Kind { Read, Write };
+
+		Kind kind = Kind::Read;
+		std::uint64_t offset = 0;
+		char* data = nullptr;
+		std::size_t size = 0;
+
+		static IoRequest ReadAt(std::uint64_t _offset, char* _data, std::size_t _size) { return { Kind::Read, _offset, _data, _size }; }
+		static IoRequest WriteAt(std::uint64_t _offset, const char* _data, std::size_t _size) { return { Kind::Write, _offset, const_cast<char*>(_data), _size }; }
+	};
+
+	/// AsyncFileIO
+	/// ------------------------------------------------------------
+	/// Positional file reads and writes that complete on the engine's own threads, so a
+	/// handler can wait for the disk without blocking a pool worker. Uses the asio file
+	/// support where the platform has it: I/O completion ports on Windows, io_uring on
+	/// Linux when Boost is built with BOOST_ASIO_HAS_IO_URING. Elsewhere the operations
+	/// run as blocking pread/pwrite on a dedicated pool.
+	/// Files must be closed before the engine is destroyed.
+	class AsyncFileIO
+	{
+	public:
+		using IoCallback = std::function<void(IoResult)>;
+		using BatchCallback = std::function<void(std::vector<IoResult>)>;
+
+#if defined(BOOST_ASIO_HAS_FILE)
+		static constexpr bool kNativeAsync = true;
+#else
+		static constexpr bool kNativeAsync = false;
+#endif
+
+		class File : public std::enable_shared_from_this<File>
+		{
+		private:
+			friend class AsyncFileIO;
+
+			AsyncFileIO& engine;
+#if defined(BOOST_ASIO_HAS_FILE)
+			asio::random_access_file file;
+#else
+			int fileDescriptor = -1;
+#endif
+
+		public:
+			explicit File(AsyncFileIO& _engine)
+				: engine(_engine)
+#if defined(BOOST_ASIO_HAS_FILE)
+				, file(_engine.ioContext)
+#endif
+			{}
+
+			~File() { Close(); }
+
+			File(const File&) = delete;
+			File& operator=(const File&) = delete;
+
+			bool IsOpen() const
+			{
+#if defined(BOOST_ASIO_HAS_FILE)
+				return file.is_open();
+#else
+				return fileDescriptor != -1;
+#endif
+			}
+
+			void Close()
+			{
+#if defined(BOOST_ASIO_HAS_FILE)
+				boost::system::error_code errorCode;
+				file.close(errorCode);
+#else
+				if (fileDescriptor != -1)
+				{
+					close(fileDescriptor);
+					fileDescriptor = -1;
+				}
+#endif
+			}
+
+			std::uint64_t Size() const
+			{
+#if defined(BOOST_ASIO_HAS_FILE)
+				boost::system::error_code errorCode;
+				return file.size(errorCode);
+#else
+				struct stat fileStat;
+				return fstat(fileDescriptor, &fileStat) == 0 ? static_cast<std::uint64_t>(fileStat.st_size) : 0;
+#endif
+			}
+
+			/// Reads _size bytes at _offset into _data, which must stay valid until _onDone runs
+			/// on an engine thread
+			void ReadAt(std::uint64_t _offset, char* _data, std::size_t _size, IoCallback _onDone)
+			{
+				Start(IoRequest::ReadAt(_offset, _data, _size), std::move(_onDone));
+			}
+
+			std::future<IoResult> ReadAt(std::uint64_t _offset, char* _data, std::size_t _size)
+			{
+				return AsFuture(IoRequest::ReadAt(_offset, _data, _size));
+			}
+
+			// co_await from a coroutine handler, resumed on the handler's pool
+			Pool::AsyncResult<IoResult> ReadAtAsync(std::uint64_t _offset, char* _data, std::size_t _size)
+			{
+				return AsAsyncResult(IoRequest::ReadAt(_offset, _data, _size));
+			}
+
+			void WriteAt(std::uint64_t _offset, const char* _data, std::size_t _size, IoCallback _onDone)
+			{
+				Start(IoRequest::WriteAt(_offset, _data, _size), std::move(_onDone));
+			}
+
+			std::future<IoResult> WriteAt(std::uint64_t _offset, const char* _data, std::size_t _size)
+			{
+				return AsFuture(IoRequest::WriteAt(_offset, _data, _size));
+			}
+
+			Pool::AsyncResult<IoResult> WriteAtAsync(std::uint64_t _offset, const char* _data, std::size_t _size)
+			{
+				return AsAsyncResult(IoRequest::WriteAt(_offset, _data, _size));
+			}
+
+			/// Starts every request at once and calls _onDone with their results, in request
+			/// order, when the last one finishes. The kernel is free to reorder them, so
+			/// overlapping writes in one batch have no defined outcome.
+			void Submit(std::vector<IoRequest> _requests, BatchCallback _onDone)
+			{
+				if (_requests.empty())
+				{
+					_onDone({});
+					return;
+				}
+
+				struct Batch
+				{
+					std::vector<IoResult> results;
+					std::atomic<std::size_t> remaining;
+					BatchCallback onDone;
+				};
+
+				auto batch = std::make_shared<Batch>();
+				batch->results.resize(_requests.size());
+				batch->remaining = _requests.size();
+				batch->onDone = std::move(_onDone);
+
+				for (std::size_t i = 0; i < _requests.size(); i++)
+				{
+					Start(_requests[i],
+						[batch, i](IoResult _result)
+						{
+							batch->results[i] = _result;
+							if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+							{
+								batch->onDone(std::move(batch->results));
+							}
+						}
+					);
+				}
+			}
+
+			std::future<std::vector<IoResult>> Submit(std::vector<IoRequest> _requests)
+			{
+				auto promise = std::make_shared<std::promise<std::vector<IoResult>>>();
+				std::future<std::vector<IoResult>> future = promise->get_future();
+
+				Submit(std::move(_requests), [promise](std::vector<IoResult> _results) { promise->set_value(std::move(_results)); });
+				return future;
+			}
+
+			Pool::AsyncResult<std::vector<IoResult>> SubmitAsync(std::vector<IoRequest> _requests)
+			{
+				Pool::AsyncResult<std::vector<IoResult>> result;
+
+				Submit(std::move(_requests), [result](std::vector<IoResult> _results) { result.Complete(std::move(_results)); });
+				return result;
+			}
+
+		private:
+			bool Open(const PathStruct& _path, AsyncOpenMode _mode, boost::system::error_code& _error)
+			{
+#if defined(BOOST_ASIO_HAS_FILE)
+#if defined(_WIN32)
+				// random_access_file::open goes through CreateFileA, which takes the UTF-8 path as ANSI
+				DWORD access = GENERIC_READ;
+				DWORD disposition = OPEN_EXISTING;
+				if (_mode == AsyncOpenMode::Write)
+				{
+					access = GENERIC_WRITE;
+					disposition = CREATE_ALWAYS;
+				}
+				else if (_mode == AsyncOpenMode::ReadWrite)
+				{
+					access = GENERIC_READ | GENERIC_WRITE;
+					disposition = OPEN_ALWAYS;
+				}
+
+				HANDLE handle = CreateFileW(_path.GetPathW().c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, disposition,
+											FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+				if (handle == INVALID_HANDLE_VALUE)
+				{
+					_error = boost::system::error_code(static_cast<int>(GetLastError()), boost::system::system_category());
+					return false;
+				}
+
+				file.assign(handle, _error);
+				if (_error)
+				{
+					CloseHandle(handle);
+					return false;
+				}
+				return true;
+#else
+				asio::file_base::flags flags = asio::file_base::read_only;
+				if (_mode == AsyncOpenMode::Write)
+				{
+					flags = asio::file_base::write_only | asio::file_base::create | asio::file_base::truncate;
+				}
+				else if (_mode == AsyncOpenMode::ReadWrite)
+				{
+					flags = asio::file_base::read_write | asio::file_base::create;
+				}
+
+				file.open(_path.GetPath(), flags, _error);
+				return !_error;
+#endif
+#else
+				int flags = O_RDONLY;
+				if (_mode == AsyncOpenMode::Write)
+				{
+					flags = O_WRONLY | O_CREAT | O_TRUNC;
+				}
+				else if (_mode == AsyncOpenMode::ReadWrite)
+				{
+					flags = O_RDWR | O_CREAT;
+				}
+
+				fileDescriptor = open(_path.GetPath().c_str(), flags | O_CLOEXEC, 0644);
+				if (fileDescriptor == -1)
+				{
+					_error = boost::system::error_code(errno, boost::system::system_category());
+					return false;
+				}
+				return true;
+#endif
+			}
+
+			void Start(const IoRequest& _request, IoCallback _onDone)
+			{
+				// Paired with Stop: either it sees this operation counted or we see it stopping
+				engine.startedOps.fetch_add(1);
+				if (engine.stopping.load())
+				{
+					engine.FinishOperation();
+					_onDone(IoResult{ asio::error::operation_aborted, 0 });
+					return;
+				}
+
+#if defined(BOOST_ASIO_HAS_FILE)
+				auto handler = [self = this->shared_from_this(), onDone = std::move(_onDone)](boost::system::error_code _error, std::size_t _transferred)
+				{
+					// A short read at the end of the file is not a failure
+					if (_error == asio::error::eof)
+					{
+						_error.clear();
+					}
+					Completion completion(self->engine);
+					onDone(IoResult{ _error, _transferred });
+				};
+
+				if (_request.kind == IoRequest::Kind::Read)
+				{
+					asio::async_read_at(file, _request.offset, asio::buffer(_request.data, _request.size), std::move(handler));
+				}
+				else
+				{
+					asio::async_write_at(file, _request.offset, asio::buffer(_request.data, _request.size), std::move(handler));
+				}
+#else
+				engine.blockingPool->Submit(
+					[self = this->shared_from_this(), request = _request, onDone = std::move(_onDone)]()
+					{
+						Completion completion(self->engine);
+						onDone(self->RunBlocking(request));
+					}
+				);
+#endif
+			}
+
+#if !defined(BOOST_ASIO_HAS_FILE)
+			IoResult RunBlocking(const IoRequest& _request) const
+			{
+				IoResult result;
+				while (result.transferred < _request.size)
+				{
+					char* data = _request.data + result.transferred;
+					const std::size_t size = _request.size - result.transferred;
+					const off_t offset = static_cast<off_t>(_request.offset + result.transferred);
+
+					const ssize_t done = _request.kind == IoRequest::Kind::Read ? pread(fileDescriptor, data, size, offset) : pwrite(fileDescriptor, data, size, offset);
+					if (done < 0)
+					{
+						if (errno == EINTR)
+						{
+							continue;
+						}
+						result.error = boost::system::error_code(errno, boost::system::system_category());
+						break;
+					}
+					if (done == 0)
+					{
+						// End of file
+						break;
+					}
+					result.transferred += static_cast<std::size_t>(done);
+				}
+				return result;
+			}
+#endif
+
+			std::future<IoResult> AsFuture(const IoRequest& _request)
+			{
+				auto promise = std::make_shared<std::promise<IoResult>>();
+				std::future<IoResult> future = promise->get_future();
+
+				Start(_request, [promise](IoResult _result) { promise->set_value(_result); });
+				return future;
+			}
+
+			Pool::AsyncResult<IoResult> AsAsyncResult(const IoRequest& _request)
+			{
+				Pool::AsyncResult<IoResult> result;
+
+				Start(_request, [result](IoResult _result) { result.Complete(_result); });
+				return result;
+			}
+		};
+
+	private:
+		asio::io_service ioContext;
+		asio::executor_work_guard<asio::io_service::executor_type> workGuard;
+		std::vector<std::thread> threadsContext;
+#if !defined(BOOST_ASIO_HAS_FILE)
+		std::unique_ptr<Pool::ThreadPool> blockingPool;
+#endif
+		// Operations started and not completed yet, Stop waits for them
+		std::atomic<std::size_t> startedOps = 0;
+		std::atomic<bool> stopping = false;
+		std::mutex opsMutex;
+		std::condition_variable opsDone;
+
+		// Engine whose completion callback runs on this thread, if any
+		static inline thread_local const AsyncFileIO* completingEngine = nullptr;
+
+		// Counts an operation out once its callback returns or throws
+		class Completion
+		{
+		private:
+			AsyncFileIO& engine;
+			const AsyncFileIO* outer;
+
+		public:
+			explicit Completion(AsyncFileIO& _engine) : engine(_engine), outer(completingEngine) { completingEngine = &_engine; }
+			~Completion()
+			{
+				completingEngine = outer;
+				engine.FinishOperation();
+			}
+
+			Completion(const Completion&) = delete;
+			Completion& operator=(const Completion&) = delete;
+		};
+
+		void FinishOperation()
+		{
+			if (startedOps.fetch_sub(1) == 1)
+			{
+				// Under the lock, so Stop cannot miss it between its check and its wait
+				std::lock_guard<std::mutex> lock(opsMutex);
+				opsDone.notify_all();
+			}
+		}
+
+	public:
+		/// _threads run the completions, and without native async I/O also block in the
+		/// system calls, so size it for the number of operations expected in flight
+		explicit AsyncFileIO(std::size_t _threads = 1)
+			: workGuard(asio::make_work_guard(ioContext))
+		{
+			const std::size_t threads = std::max<std::size_t>(_threads, 1);
+#if defined(BOOST_ASIO_HAS_FILE)
+			for (std::size_t i = 0; i < threads; i++)
+			{
+				threadsContext.emplace_back([this]() { ioContext.run(); });
+			}
+#else
+			blockingPool = std::make_unique<Pool::ThreadPool>(static_cast<DWORD>(threads));
+#endif
+		}
+
+		~AsyncFileIO() { Stop(); }
+
+		AsyncFileIO(const AsyncFileIO&) = delete;
+		AsyncFileIO& operator=(const AsyncFileIO&) = delete;
+
+		// nullptr with _error set when the file cannot be opened
+		std::shared_ptr<File> Open(const PathStruct& _path, AsyncOpenMode _mode, boost::system::error_code& _error)
+		{
+			auto file = std::make_shared<File>(*this);
+			if (!file->Open(_path, _mode, _error))
+			{
+				return nullptr;
+			}
+			return file;
+		}
+
+		std::shared_ptr<File> Open(const PathStruct& _path, AsyncOpenMode _mode)
+		{
+			boost::system::error_code errorCode;
+			return Open(_path, _mode, errorCode);
+		}
+
+		/// Waits until every started operation has completed, including those still queued
+		/// for the blocking pool. Operations started afterwards complete at once with
+		/// operation_aborted. Called from a completion callback it only does the latter, an
+		/// engine thread cannot wait for itself; the wait is left to a later Stop or the
+		/// destructor, which must run on another thread.
+		void Stop()
+		{
+			stopping.store(true);
+			if (completingEngine == this)
+			{
+				return;
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(opsMutex);
+				opsDone.wait(lock, [this]() { return startedOps.load() == 0; });
+			}
+
+#if !defined(BOOST_ASIO_HAS_FILE)
+			if (blockingPool)
+			{
+				blockingPool->Join();
+			}
+#endif
+			workGuard.reset();
+			for (std::thread& thread : threadsContext)
+			{
+				if (thread.joinable())
+				{
+					thread.join();
+				}
+			}
+			threadsContext.clear();
+		}
+	};
+}
\ No newline at end of file
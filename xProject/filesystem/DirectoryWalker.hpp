@@ -0,0 +1,378 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "PathStruct.hpp"
+#include "utils/ThreadPool.hpp"
+
+namespace FileS
+{
+
+	enum class EntryType : std::uint8_t
+	{
+		File,
+		Directory,
+		// Reported, never followed
+		Symlink,
+		Other
+	};
+
+	/// One directory entry, the views are valid only during the callback
+	struct DirectoryEntry
+	{
+		std::string_view path;
+		std::string_view name;
+		EntryType type = EntryType::Other;
+		// Known on Windows from the directory listing, elsewhere only with WalkOptions::statFiles
+		std::optional<std::uint64_t> size;
+		std::optional<std::chrono::system_clock::time_point> lastWriteTime;
+		// 0 for the entries of the root
+		std::size_t depth = 0;
+	};
+
+	struct WalkOptions
+	{
+		// Entries deeper than this are not reported, 0 lists the root only
+		std::size_t maxDepth = std::numeric_limits<std::size_t>::max();
+		// Also report the directories themselves
+		bool includeDirectories = true;
+		// Stat every file for its size and write time where the listing does not carry them
+		bool statFiles = false;
+
+		// Entries it rejects are not reported, directories are still entered
+		std::function<bool(const DirectoryEntry&)> filter;
+		// Directories it rejects are not entered
+		std::function<bool(const DirectoryEntry&)> descend;
+	};
+
+	struct WalkResult
+	{
+		std::size_t entries = 0;
+		std::size_t directories = 0;
+		// Directories that could not be opened or read
+		std::size_t errors = 0;
+	};
+
+	/// DirectoryWalker
+	/// ------------------------------------------------------------
+	/// Recursive directory traversal spread over a thread pool, one task per directory.
+	/// Entries are handed to the callback straight from the listing buffer in no
+	/// particular order, from several pool threads at once. Files cost no system call
+	/// beyond the directory read unless their size is asked for.
+	/// Walk blocks until the tree is done, so do not call it from a thread of the same pool.
+	/// An exception from the callback, filter or descend stops the walk, Walk rethrows the
+	/// first one after the tasks already running have finished.
+	class DirectoryWalker
+	{
+	public:
+		using EntryCallback = std::function<void(const DirectoryEntry&)>;
+
+	private:
+		struct WalkState
+		{
+			EntryCallback onEntry;
+			std::atomic<std::size_t> pending = 0;
+			std::atomic<std::size_t> entries = 0;
+			std::atomic<std::size_t> directories = 0;
+			std::atomic<std::size_t> errors = 0;
+
+			// Set once by the first throwing callback, remaining entries are skipped
+			std::atomic<bool> failed = false;
+			std::exception_ptr error;
+
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+
+		Pool::ThreadPool& threadPool;
+		WalkOptions options;
+
+	public:
+		explicit DirectoryWalker(Pool::ThreadPool& _threadPool, WalkOptions _options = WalkOptions())
+			: threadPool(_threadPool), options(std::move(_options)) {}
+
+		WalkResult Walk(const PathStruct& _root, EntryCallback _onEntry)
+		{
+			auto state = std::make_shared<WalkState>();
+			state->onEntry = std::move(_onEntry);
+			state->pending = 1;
+
+			threadPool.Submit(&DirectoryWalker::Visit, this, state, _root.GetPath(), std::size_t(0));
+
+			{
+				std::unique_lock<std::mutex> lock(state->mutex);
+				state->done.wait(lock, [&state]() { return state->pending.load(std::memory_order_acquire) == 0; });
+			}
+
+			if (state->error)
+			{
+				std::rethrow_exception(state->error);
+			}
+
+			WalkResult result;
+			result.entries = state->entries.load(std::memory_order_relaxed);
+			result.directories = state->directories.load(std::memory_order_relaxed);
+			result.errors = state->errors.load(std::memory_order_relaxed);
+			return result;
+		}
+
+	private:
+		void Visit(std::shared_ptr<WalkState> _state, std::string _directory, std::size_t _depth)
+		{
+			std::vector<std::string> subdirectories;
+
+			// Reused for every entry of the directory
+			std::string entryPath = _directory;
+			if (entryPath.empty() || !IsPathSeparator(entryPath.back()))
+			{
+				entryPath.push_back(kPathSeparator);
+			}
+			const std::size_t prefixLength = entryPath.size();
+
+			const bool listed = ReadDirectory(_directory,
+				[&](std::string_view _name, EntryType _type, std::optional<std::uint64_t> _size, std::optional<std::chrono::system_clock::time_point> _lastWriteTime)
+				{
+					if (_state->failed.load(std::memory_order_relaxed))
+					{
+						return;
+					}
+
+					entryPath.resize(prefixLength);
+					entryPath.append(_name);
+
+					DirectoryEntry entry;
+					entry.path = entryPath;
+					entry.name = std::string_view(entryPath).substr(prefixLength);
+					entry.type = _type;
+					entry.size = _size;
+					entry.lastWriteTime = _lastWriteTime;
+					entry.depth = _depth;
+
+					if (_type == EntryType::Directory)
+					{
+						_state->directories.fetch_add(1, std::memory_order_relaxed);
+					}
+
+					// Caught here so the listing handle is still closed and pending still counts down
+					try
+					{
+						if ((_type != EntryType::Directory || options.includeDirectories) && (!options.filter || options.filter(entry)))
+						{
+							_state->entries.fetch_add(1, std::memory_order_relaxed);
+							_state->onEntry(entry);
+						}
+
+						if (_type == EntryType::Directory && _depth < options.maxDepth && (!options.descend || options.descend(entry)))
+						{
+							subdirectories.push_back(entryPath);
+						}
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(_state->mutex);
+						if (!_state->failed.exchange(true, std::memory_order_relaxed))
+						{
+							_state->error = std::current_exception();
+						}
+					}
+				}
+			);
+
+			if (!listed)
+			{
+				_state->errors.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			if (_state->failed.load(std::memory_order_relaxed))
+			{
+				subdirectories.clear();
+			}
+
+			// Counted before this task finishes, so pending cannot reach zero early
+			_state->pending.fetch_add(subdirectories.size(), std::memory_order_relaxed);
+			for (std::string& subdirectory : subdirectories)
+			{
+				threadPool.Submit(&DirectoryWalker::Visit, this, _state, std::move(subdirectory), _depth + 1);
+			}
+
+			if (_state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				std::lock_guard<std::mutex> lock(_state->mutex);
+				_state->done.notify_all();
+			}
+		}
+
+		template<typename OnEntry>
+		bool ReadDirectory(const std::string& _directory, OnEntry&& _onEntry) const
+		{
+#ifdef _WIN32
+			PathStruct pattern(_directory);
+			pattern.Append("*");
+
+			WIN32_FIND_DATAW findData;
+			HANDLE findHandle = FindFirstFileExW(pattern.GetPathW().c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+			if (findHandle == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			std::string name;
+			do
+			{
+				const wchar_t* nameW = findData.cFileName;
+				if (nameW[0] == L'.' && (nameW[1] == L'\0' || (nameW[1] == L'.' && nameW[2] == L'\0')))
+				{
+					continue;
+				}
+
+				const int length = WideCharToMultiByte(CP_UTF8, 0, nameW, -1, nullptr, 0, nullptr, nullptr);
+				name.resize(length > 0 ? static_cast<std::size_t>(length - 1) : 0);
+				WideCharToMultiByte(CP_UTF8, 0, nameW, -1, name.data(), length, nullptr, nullptr);
+
+				const DWORD attributes = findData.dwFileAttributes;
+				EntryType type = EntryType::File;
+				if (attributes & FILE_ATTRIBUTE_REPARSE_POINT)
+				{
+					type = EntryType::Symlink;
+				}
+				else if (attributes & FILE_ATTRIBUTE_DIRECTORY)
+				{
+					type = EntryType::Directory;
+				}
+
+				std::optional<std::uint64_t> size;
+				if (type == EntryType::File)
+				{
+					size = (static_cast<std::uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+				}
+
+				_onEntry(std::string_view(name), type, size, TimeOf(findData.ftLastWriteTime));
+			} while (FindNextFileW(findHandle, &findData));
+
+			FindClose(findHandle);
+			return true;
+#else
+			const int directoryFd = open(_directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (directoryFd == -1)
+			{
+				return false;
+			}
+
+			// Layout the getdents64 system call fills in
+			struct LinuxDirent64
+			{
+				std::uint64_t inode;
+				std::int64_t offset;
+				unsigned short recordLength;
+				unsigned char type;
+				char name[1];
+			};
+
+			// Large reads keep the system calls per directory low
+			constexpr std::size_t kBufferSize = 64 * 1024;
+			thread_local std::unique_ptr<char[]> buffer = std::make_unique<char[]>(kBufferSize);
+
+			bool ok = true;
+			while (true)
+			{
+				const long read = syscall(SYS_getdents64, directoryFd, buffer.get(), kBufferSize);
+				if (read == 0)
+				{
+					break;
+				}
+				if (read < 0)
+				{
+					ok = false;
+					break;
+				}
+
+				for (long position = 0; position < read;)
+				{
+					const LinuxDirent64* dirent = reinterpret_cast<const LinuxDirent64*>(buffer.get() + position);
+					position += dirent->recordLength;
+
+					const char* name = dirent->name;
+					if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+					{
+						continue;
+					}
+
+					EntryType type = TypeOf(dirent->type);
+					std::optional<std::uint64_t> size;
+					std::optional<std::chrono::system_clock::time_point> lastWriteTime;
+
+					// Some file systems leave the type out, stat relative to the open directory
+					if (dirent->type == DT_UNKNOWN || (options.statFiles && type == EntryType::File))
+					{
+						struct stat fileStat;
+						if (fstatat(directoryFd, name, &fileStat, AT_SYMLINK_NOFOLLOW) == 0)
+						{
+							type = TypeOfMode(fileStat.st_mode);
+							if (type == EntryType::File && options.statFiles)
+							{
+								size = static_cast<std::uint64_t>(fileStat.st_size);
+								lastWriteTime = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+									std::chrono::seconds(fileStat.st_mtim.tv_sec) + std::chrono::nanoseconds(fileStat.st_mtim.tv_nsec)));
+							}
+						}
+					}
+
+					_onEntry(std::string_view(name), type, size, lastWriteTime);
+				}
+			}
+
+			close(directoryFd);
+			return ok;
+#endif
+		}
+
+#ifdef _WIN32
+		static std::chrono::system_clock::time_point TimeOf(const FILETIME& _fileTime)
+		{
+			// FILETIME counts 100 ns intervals since 1601-01-01
+			constexpr std::int64_t kUnixEpochFileTime = 116444736000000000ll;
+			const std::int64_t fileTime = static_cast<std::int64_t>((static_cast<std::uint64_t>(_fileTime.dwHighDateTime) << 32) | _fileTime.dwLowDateTime);
+			return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+				std::chrono::nanoseconds((fileTime - kUnixEpochFileTime) * 100)));
+		}
+#else
+		static EntryType TypeOf(unsigned char _direntType)
+		{
+			switch (_direntType)
+			{
+			case DT_REG: return EntryType::File;
+			case DT_DIR: return EntryType::Directory;
+			case DT_LNK: return EntryType::Symlink;
+			default:     return EntryType::Other;
+			}
+		}
+
+		static EntryType TypeOfMode(mode_t _mode)
+		{
+			if (S_ISREG(_mode)) { return EntryType::File; }
+			if (S_ISDIR(_mode)) { return EntryType::Directory; }
+			if (S_ISLNK(_mode)) { return EntryType::Symlink; }
+			return EntryType::Other;
+		}
+#endif
+	};
+}
\ No newline at end of file
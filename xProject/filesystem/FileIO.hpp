@@ -2,6 +2,7 @@
 
 #include "xProject_pch.hpp"
 
+#include "MappedFile.hpp"
 #include "PathStruct.hpp"
 
 namespace FileS
@@ -24,6 +25,7 @@ namespace FileS
 
         bool Open(const PathStruct& _filePath, std::ios_base::openmode _mode)
         {
+            filePath = _filePath;
             fileStream.open(_filePath.GetPath(), _mode);
             return IsOpen();
         }
@@ -42,6 +44,11 @@ namespace FileS
             return fileStream.is_open();
         }
 
+        const PathStruct& Path() const
+        {
+            return filePath;
+        }
+
         std::streampos Size()
         {
             fileStream.seekg(0, std::ios::end);
@@ -59,5 +66,16 @@ namespace FileS
         {
             return fileStream.write(_str, _size);
         }
+
+        /// Maps the file this FileIO was opened on, for zero-copy access to large files.
+        /// Pending stream writes are flushed first so the map sees them.
+        MappedFile Map(MapMode _mode, AccessHint _hint = AccessHint::Normal)
+        {
+            if (IsOpen())
+            {
+                fileStream.flush();
+            }
+            return MappedFile(filePath, _mode, _hint);
+        }
     };
 }
\ No newline at end of file
@@ -1,5 +1,10 @@
 #pragma once
 
+#include "filesystem/AsyncFileIO.hpp"
 #include "filesystem/FileIO.hpp"
+#include "filesystem/FileWatcher.hpp"
 #include "filesystem/FilesystemManager.hpp"
-#include "filesystem/PathStruct.hpp"
\ No newline at end of file
+#include "filesystem/LineReader.hpp"
+#include "filesystem/MappedFile.hpp"
+#include "filesystem/PathStruct.hpp"
+#include "filesystem/WriteAheadLog.hpp"
\ No newline at end of file
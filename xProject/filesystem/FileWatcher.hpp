@@ -0,0 +1,874 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "DirectoryWalker.hpp"
+#include "PathStruct.hpp"
+#include "collections/QeueuLockfree.hpp"
+#include "utils/ThreadPool.hpp"
+
+namespace FileS
+{
+
+	enum class FileEventType : std::uint8_t
+	{
+		Created,
+		Modified,
+		Deleted,
+		// Renamed inside the watched tree, oldPath holds the previous name
+		Moved,
+		// Events were lost, the consumer should rescan the tree under path
+		Overflow
+	};
+
+	struct FileEvent
+	{
+		FileEventType type = FileEventType::Modified;
+		// The watched root joined with the relative name
+		std::string path;
+		std::string oldPath;
+		bool isDirectory = false;
+	};
+
+	struct WatchOptions
+	{
+		// Watch the subdirectories too, including the ones created later
+		bool recursive = true;
+		// Events for one path inside this window are delivered as one
+		std::chrono::milliseconds coalesceWindow{ 50 };
+		// Scan interval of the polling backend
+		std::chrono::milliseconds pollInterval{ 1000 };
+		// Poll even where notifications exist, for network shares and mounts that never send them
+		bool forcePolling = false;
+	};
+
+	/// EventCoalescer
+	/// ------------------------------------------------------------
+	/// Merges the events of one path that arrive within a window, keeping first-seen order.
+	/// A file created and deleted inside the window disappears, a save through a temporary
+	/// file and a rename reads as one Created of the target.
+	class EventCoalescer
+	{
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		std::vector<std::optional<FileEvent>> pending;
+		std::unordered_map<std::string, std::size_t> byPath;
+		Clock::time_point firstPending;
+
+	public:
+		void Add(FileEvent _event, Clock::time_point _now = Clock::now())
+		{
+			if (pending.empty())
+			{
+				firstPending = _now;
+			}
+
+			if (_event.type == FileEventType::Moved)
+			{
+				auto source = byPath.find(_event.oldPath);
+				if (source != byPath.end() && pending[source->second]->type == FileEventType::Created)
+				{
+					pending[source->second].reset();
+					byPath.erase(source);
+					_event.type = FileEventType::Created;
+					_event.oldPath.clear();
+				}
+			}
+
+			auto found = byPath.find(_event.path);
+			if (found == byPath.end())
+			{
+				byPath.emplace(_event.path, pending.size());
+				pending.push_back(std::move(_event));
+				return;
+			}
+
+			std::optional<FileEvent>& existing = pending[found->second];
+			switch (_event.type)
+			{
+			case FileEventType::Created:
+			case FileEventType::Modified:
+				// Deleted and back again is a change of content
+				if (existing->type == FileEventType::Deleted)
+				{
+					existing->type = FileEventType::Modified;
+					existing->isDirectory = _event.isDirectory;
+				}
+				break;
+			case FileEventType::Deleted:
+				if (existing->type == FileEventType::Created)
+				{
+					existing.reset();
+					byPath.erase(found);
+				}
+				else if (existing->type == FileEventType::Moved)
+				{
+					existing->type = FileEventType::Deleted;
+					existing->path = std::move(existing->oldPath);
+					existing->oldPath.clear();
+					byPath.erase(found);
+				}
+				else
+				{
+					existing->type = FileEventType::Deleted;
+				}
+				break;
+			case FileEventType::Moved:
+			case FileEventType::Overflow:
+				// Supersedes what was pending for the target, delivered in its own place
+				existing.reset();
+				found->second = pending.size();
+				pending.push_back(std::move(_event));
+				break;
+			}
+		}
+
+		bool Empty() const
+		{
+			return byPath.empty();
+		}
+
+		bool Due(std::chrono::milliseconds _window, Clock::time_point _now = Clock::now()) const
+		{
+			return !pending.empty() && _now - firstPending >= _window;
+		}
+
+		// Time left until Due, zero when nothing is pending
+		std::chrono::milliseconds Remaining(std::chrono::milliseconds _window, Clock::time_point _now = Clock::now()) const
+		{
+			if (pending.empty())
+			{
+				return std::chrono::milliseconds(0);
+			}
+			const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(_now - firstPending);
+			return elapsed >= _window ? std::chrono::milliseconds(0) : _window - elapsed;
+		}
+
+		template<typename Deliver>
+		void Flush(Deliver&& _deliver)
+		{
+			for (std::optional<FileEvent>& event : pending)
+			{
+				if (event)
+				{
+					_deliver(std::move(*event));
+				}
+			}
+			pending.clear();
+			byPath.clear();
+		}
+	};
+
+	/// FileWatcher
+	/// ------------------------------------------------------------
+	/// Watches a directory tree on its own thread and delivers coalesced events to a
+	/// callback or, without one, to the Events queue. Linux uses inotify with a watch per
+	/// directory, Windows one ReadDirectoryChangesW on the root, anything else or
+	/// WatchOptions::forcePolling compares directory snapshots.
+	/// When the kernel drops events the watcher delivers Overflow and restores its
+	/// watches, the consumer rescans from there.
+	class FileWatcher
+	{
+	public:
+		using EventCallback = std::function<void(const FileEvent&)>;
+
+	private:
+		// Upper bound on one wait, also how long Stop may take
+		static constexpr std::chrono::milliseconds kMaxWait{ 100 };
+
+		struct SnapshotEntry
+		{
+			bool isDirectory = false;
+			std::uint64_t size = 0;
+			std::chrono::system_clock::time_point lastWriteTime{};
+		};
+
+		WatchOptions options;
+		EventCallback onEvent;
+		Utils::QueueLF<FileEvent> events;
+		EventCoalescer coalescer;
+
+		std::string root;
+		std::thread thread;
+		std::atomic_bool running = false;
+		// Cleared by the watcher thread when the native backend breaks
+		std::atomic_bool native = false;
+
+		// Listings for the polling backend and for new directories under inotify
+		std::unique_ptr<Pool::ThreadPool> scanPool;
+		std::unordered_map<std::string, SnapshotEntry> snapshot;
+
+#if defined(__linux__)
+		struct PendingMove
+		{
+			std::uint32_t cookie = 0;
+			std::string path;
+			bool isDirectory = false;
+		};
+
+		int inotifyFd = -1;
+		std::unordered_map<int, std::string> watches;
+		std::vector<PendingMove> pendingMoves;
+#elif defined(_WIN32)
+		HANDLE directoryHandle = INVALID_HANDLE_VALUE;
+		OVERLAPPED overlapped{};
+		// ReadDirectoryChangesW wants DWORD alignment
+		std::vector<DWORD> buffer;
+		std::string renamedFrom;
+#endif
+
+	public:
+		explicit FileWatcher(WatchOptions _options = WatchOptions()) : options(std::move(_options)) {}
+		~FileWatcher() { Stop(); }
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		// Set before Start, it runs on the watcher thread
+		void SetCallback(EventCallback _onEvent)
+		{
+			onEvent = std::move(_onEvent);
+		}
+
+		bool Start(const PathStruct& _root)
+		{
+			if (running.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			PathStruct rootPath(_root);
+			rootPath.RefreshMetadata();
+			if (!rootPath.IsDirectory())
+			{
+				return false;
+			}
+
+			root = rootPath.GetPath();
+			if (root.size() > 1 && IsPathSeparator(root.back()))
+			{
+				root.pop_back();
+			}
+
+			native = !options.forcePolling && OpenNative();
+			if (!native)
+			{
+				snapshot = TakeSnapshot();
+			}
+
+			running.store(true, std::memory_order_release);
+			thread = std::thread(&FileWatcher::Run, this);
+			return true;
+		}
+
+		// Delivers what is still pending and wakes the consumers waiting on Events
+		void Stop()
+		{
+			if (!running.exchange(false, std::memory_order_acq_rel))
+			{
+				return;
+			}
+
+			thread.join();
+			CloseNative();
+			events.stop_wait();
+		}
+
+		Utils::QueueLF<FileEvent>& Events()
+		{
+			return events;
+		}
+
+		bool IsRunning() const
+		{
+			return running.load(std::memory_order_acquire);
+		}
+
+		// False when the watcher fell back to polling
+		bool IsNative() const
+		{
+			return native;
+		}
+
+		const std::string& Root() const
+		{
+			return root;
+		}
+
+	private:
+		void Run()
+		{
+			auto nextPoll = std::chrono::steady_clock::now() + options.pollInterval;
+
+			while (running.load(std::memory_order_acquire))
+			{
+				std::chrono::milliseconds timeout = kMaxWait;
+				if (!coalescer.Empty())
+				{
+					timeout = std::min(timeout, coalescer.Remaining(options.coalesceWindow));
+				}
+
+				if (native)
+				{
+					WaitNative(timeout);
+				}
+				else
+				{
+					const auto untilPoll = std::chrono::duration_cast<std::chrono::milliseconds>(nextPoll - std::chrono::steady_clock::now());
+					std::this_thread::sleep_for(std::max(std::chrono::milliseconds(0), std::min(timeout, untilPoll)));
+
+					if (std::chrono::steady_clock::now() >= nextPoll)
+					{
+						Rescan();
+						nextPoll = std::chrono::steady_clock::now() + options.pollInterval;
+					}
+				}
+
+				if (coalescer.Due(options.coalesceWindow))
+				{
+					Flush();
+				}
+			}
+
+			Flush();
+		}
+
+		void Add(FileEventType _type, std::string _path, bool _isDirectory, std::string _oldPath = std::string())
+		{
+			FileEvent event;
+			event.type = _type;
+			event.path = std::move(_path);
+			event.oldPath = std::move(_oldPath);
+			event.isDirectory = _isDirectory;
+			coalescer.Add(std::move(event));
+		}
+
+		void Flush()
+		{
+			coalescer.Flush([this](FileEvent&& _event) { Deliver(std::move(_event)); });
+		}
+
+		void Deliver(FileEvent&& _event)
+		{
+			if (onEvent)
+			{
+				onEvent(_event);
+			}
+			else
+			{
+				events.push_back(std::move(_event));
+			}
+		}
+
+		// What was pending goes out first, then one Overflow for the whole tree
+		void ReportOverflow()
+		{
+			Flush();
+
+			FileEvent event;
+			event.type = FileEventType::Overflow;
+			event.path = root;
+			event.isDirectory = true;
+			Deliver(std::move(event));
+		}
+
+		std::string Join(const std::string& _directory, std::string_view _name) const
+		{
+			std::string path = _directory;
+			if (path.empty() || !IsPathSeparator(path.back()))
+			{
+				path.push_back(kPathSeparator);
+			}
+			path.append(_name);
+			return path;
+		}
+
+		// Every entry under _directory with its type, size and write time
+		std::unordered_map<std::string, SnapshotEntry> List(const std::string& _directory)
+		{
+			if (!scanPool)
+			{
+				scanPool = std::make_unique<Pool::ThreadPool>(1);
+			}
+
+			WalkOptions walkOptions;
+			walkOptions.statFiles = true;
+			if (!options.recursive)
+			{
+				walkOptions.maxDepth = 0;
+			}
+
+			std::unordered_map<std::string, SnapshotEntry> entries;
+			std::mutex mutex;
+			DirectoryWalker(*scanPool, walkOptions).Walk(PathStruct(_directory),
+				[&](const DirectoryEntry& _entry)
+				{
+					SnapshotEntry entry;
+					entry.isDirectory = _entry.type == EntryType::Directory;
+					entry.size = _entry.size.value_or(0);
+					entry.lastWriteTime = _entry.lastWriteTime.value_or(std::chrono::system_clock::time_point());
+
+					std::lock_guard<std::mutex> lock(mutex);
+					entries.emplace(std::string(_entry.path), entry);
+				}
+			);
+			return entries;
+		}
+
+		std::unordered_map<std::string, SnapshotEntry> TakeSnapshot()
+		{
+			return List(root);
+		}
+
+		/// Polling backend
+		/// ------------------------------------------------------------
+		/// Directories only report creation and deletion, a file whose size or write time
+		/// changed reports Modified. Renames read as a Deleted and a Created.
+		void Rescan()
+		{
+			std::unordered_map<std::string, SnapshotEntry> current = TakeSnapshot();
+
+			for (const auto& [path, entry] : current)
+			{
+				auto previous = snapshot.find(path);
+				if (previous == snapshot.end() || previous->second.isDirectory != entry.isDirectory)
+				{
+					Add(FileEventType::Created, path, entry.isDirectory);
+				}
+				else if (!entry.isDirectory && (previous->second.size != entry.size || previous->second.lastWriteTime != entry.lastWriteTime))
+				{
+					Add(FileEventType::Modified, path, false);
+				}
+			}
+
+			for (const auto& [path, entry] : snapshot)
+			{
+				if (current.find(path) == current.end())
+				{
+					Add(FileEventType::Deleted, path, entry.isDirectory);
+				}
+			}
+
+			snapshot = std::move(current);
+		}
+
+#if defined(__linux__)
+		/// inotify backend
+		/// ------------------------------------------------------------
+		/// A watch per directory. A directory created or moved in gets its watch and
+		/// reports what it already holds, so files written before the watch existed are
+		/// not missed. A rename whose halves land in different reads is seen as a Deleted
+		/// and a Created.
+		static constexpr std::uint32_t kWatchMask = IN_CREATE | IN_MODIFY | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+			IN_DELETE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+		bool OpenNative()
+		{
+			inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (inotifyFd == -1)
+			{
+				return false;
+			}
+
+			if (!AddWatch(root))
+			{
+				close(inotifyFd);
+				inotifyFd = -1;
+				return false;
+			}
+
+			if (options.recursive)
+			{
+				WatchTree(root, false);
+			}
+			return true;
+		}
+
+		void CloseNative()
+		{
+			if (inotifyFd != -1)
+			{
+				close(inotifyFd);
+				inotifyFd = -1;
+			}
+			watches.clear();
+			pendingMoves.clear();
+		}
+
+		bool AddWatch(const std::string& _directory)
+		{
+			const int watch = inotify_add_watch(inotifyFd, _directory.c_str(), kWatchMask);
+			if (watch == -1)
+			{
+				return false;
+			}
+			// Watching an inode twice returns its existing descriptor, the path is refreshed
+			watches[watch] = _directory;
+			return true;
+		}
+
+		void WatchTree(const std::string& _directory, bool _reportEntries)
+		{
+			for (const auto& [path, entry] : List(_directory))
+			{
+				if (entry.isDirectory)
+				{
+					AddWatch(path);
+				}
+				if (_reportEntries)
+				{
+					Add(FileEventType::Created, path, entry.isDirectory);
+				}
+			}
+		}
+
+		void WatchNewDirectory(const std::string& _directory)
+		{
+			if (options.recursive && AddWatch(_directory))
+			{
+				WatchTree(_directory, true);
+			}
+		}
+
+		static bool IsUnder(const std::string& _path, const std::string& _directory)
+		{
+			return _path.size() >= _directory.size() && _path.compare(0, _directory.size(), _directory) == 0 &&
+				(_path.size() == _directory.size() || IsPathSeparator(_path[_directory.size()]));
+		}
+
+		// Watches follow the inode, only their paths change with a rename
+		void RenameWatches(const std::string& _from, const std::string& _to)
+		{
+			for (auto& [watch, path] : watches)
+			{
+				if (IsUnder(path, _from))
+				{
+					path = _to + path.substr(_from.size());
+				}
+			}
+		}
+
+		void ForgetWatches(const std::string& _directory)
+		{
+			for (auto it = watches.begin(); it != watches.end();)
+			{
+				if (IsUnder(it->second, _directory))
+				{
+					inotify_rm_watch(inotifyFd, it->first);
+					it = watches.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+
+		void WaitNative(std::chrono::milliseconds _timeout)
+		{
+			pollfd descriptor{ inotifyFd, POLLIN, 0 };
+			if (poll(&descriptor, 1, static_cast<int>(_timeout.count())) <= 0)
+			{
+				return;
+			}
+
+			alignas(inotify_event) char readBuffer[64 * 1024];
+			while (true)
+			{
+				const ssize_t read = ::read(inotifyFd, readBuffer, sizeof(readBuffer));
+				if (read <= 0)
+				{
+					break;
+				}
+
+				for (ssize_t position = 0; position < read;)
+				{
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(readBuffer + position);
+					position += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+					HandleEvent(*event);
+				}
+			}
+
+			// A move whose other half never arrived left the tree
+			for (PendingMove& move : pendingMoves)
+			{
+				if (move.isDirectory)
+				{
+					ForgetWatches(move.path);
+				}
+				Add(FileEventType::Deleted, std::move(move.path), move.isDirectory);
+			}
+			pendingMoves.clear();
+		}
+
+		void HandleEvent(const inotify_event& _event)
+		{
+			if (_event.mask & IN_Q_OVERFLOW)
+			{
+				ReportOverflow();
+				AddWatch(root);
+				if (options.recursive)
+				{
+					WatchTree(root, false);
+				}
+				return;
+			}
+
+			auto watch = watches.find(_event.wd);
+			if (watch == watches.end())
+			{
+				return;
+			}
+
+			if (_event.mask & IN_IGNORED)
+			{
+				watches.erase(watch);
+				return;
+			}
+			if (_event.mask & IN_DELETE_SELF)
+			{
+				if (watch->second == root)
+				{
+					Add(FileEventType::Deleted, root, true);
+				}
+				return;
+			}
+			if (_event.len == 0)
+			{
+				return;
+			}
+
+			std::string path = Join(watch->second, _event.name);
+			const bool isDirectory = (_event.mask & IN_ISDIR) != 0;
+
+			if (_event.mask & IN_CREATE)
+			{
+				Add(FileEventType::Created, path, isDirectory);
+				if (isDirectory)
+				{
+					WatchNewDirectory(path);
+				}
+			}
+			else if (_event.mask & IN_MODIFY)
+			{
+				Add(FileEventType::Modified, std::move(path), isDirectory);
+			}
+			else if (_event.mask & IN_DELETE)
+			{
+				Add(FileEventType::Deleted, std::move(path), isDirectory);
+			}
+			else if (_event.mask & IN_MOVED_FROM)
+			{
+				pendingMoves.push_back(PendingMove{ _event.cookie, std::move(path), isDirectory });
+			}
+			else if (_event.mask & IN_MOVED_TO)
+			{
+				auto source = std::find_if(pendingMoves.begin(), pendingMoves.end(),
+					[&_event](const PendingMove& _move) { return _move.cookie == _event.cookie; });
+
+				if (source != pendingMoves.end())
+				{
+					std::string oldPath = std::move(source->path);
+					pendingMoves.erase(source);
+					if (isDirectory)
+					{
+						RenameWatches(oldPath, path);
+					}
+					Add(FileEventType::Moved, std::move(path), isDirectory, std::move(oldPath));
+				}
+				else
+				{
+					Add(FileEventType::Created, path, isDirectory);
+					if (isDirectory)
+					{
+						WatchNewDirectory(path);
+					}
+				}
+			}
+		}
+#elif defined(_WIN32)
+		/// ReadDirectoryChangesW backend
+		/// ------------------------------------------------------------
+		/// One overlapped read on the root covers the whole tree. A zero length completion
+		/// means the buffer overflowed.
+		static constexpr DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+			FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+		bool OpenNative()
+		{
+			directoryHandle = CreateFileW(PathStruct(root).GetPathW().c_str(), FILE_LIST_DIRECTORY,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+				FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+			if (directoryHandle == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			overlapped = OVERLAPPED{};
+			overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+			buffer.resize(64 * 1024 / sizeof(DWORD));
+
+			if (overlapped.hEvent == nullptr || !IssueRead())
+			{
+				CloseNative();
+				return false;
+			}
+			return true;
+		}
+
+		void CloseNative()
+		{
+			if (directoryHandle != INVALID_HANDLE_VALUE)
+			{
+				// The buffer must outlive the read, wait for the cancel to land
+				DWORD transferred = 0;
+				CancelIoEx(directoryHandle, &overlapped);
+				GetOverlappedResult(directoryHandle, &overlapped, &transferred, TRUE);
+				CloseHandle(directoryHandle);
+				directoryHandle = INVALID_HANDLE_VALUE;
+			}
+			if (overlapped.hEvent != nullptr)
+			{
+				CloseHandle(overlapped.hEvent);
+				overlapped.hEvent = nullptr;
+			}
+		}
+
+		bool IssueRead()
+		{
+			ResetEvent(overlapped.hEvent);
+			return ReadDirectoryChangesW(directoryHandle, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(DWORD)),
+				options.recursive, kNotifyFilter, nullptr, &overlapped, nullptr);
+		}
+
+		void WaitNative(std::chrono::milliseconds _timeout)
+		{
+			if (WaitForSingleObject(overlapped.hEvent, static_cast<DWORD>(_timeout.count())) != WAIT_OBJECT_0)
+			{
+				return;
+			}
+
+			DWORD transferred = 0;
+			if (!GetOverlappedResult(directoryHandle, &overlapped, &transferred, FALSE))
+			{
+				if (GetLastError() == ERROR_NOTIFY_ENUM_DIR)
+				{
+					ReportOverflow();
+				}
+			}
+			else if (transferred == 0)
+			{
+				ReportOverflow();
+			}
+			else
+			{
+				HandleNotifications();
+			}
+
+			if (!IssueRead())
+			{
+				FallBackToPolling();
+			}
+		}
+
+		// Without a read in flight the event never fires again, typically the root was
+		// deleted. Reports what became of it and keeps watching by snapshots.
+		void FallBackToPolling()
+		{
+			if (PathStruct(root).IsDirectory())
+			{
+				ReportOverflow();
+			}
+			else
+			{
+				Add(FileEventType::Deleted, root, true);
+			}
+
+			CloseNative();
+			snapshot = TakeSnapshot();
+			native = false;
+		}
+
+		void HandleNotifications()
+		{
+			const char* position = reinterpret_cast<const char*>(buffer.data());
+			std::string name;
+
+			while (true)
+			{
+				const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(position);
+
+				const int nameLength = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+				const int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, nameLength, nullptr, 0, nullptr, nullptr);
+				name.resize(static_cast<std::size_t>(std::max(length, 0)));
+				WideCharToMultiByte(CP_UTF8, 0, info->FileName, nameLength, name.data(), length, nullptr, nullptr);
+				std::replace(name.begin(), name.end(), '\\', kPathSeparator);
+
+				std::string path = Join(root, name);
+				switch (info->Action)
+				{
+				case FILE_ACTION_ADDED:
+					Add(FileEventType::Created, path, PathStruct(path).IsDirectory());
+					break;
+				case FILE_ACTION_REMOVED:
+					// Gone, whether it was a directory is no longer known
+					Add(FileEventType::Deleted, std::move(path), false);
+					break;
+				case FILE_ACTION_MODIFIED:
+					// A directory reports Modified for every change of its entries
+					if (!PathStruct(path).IsDirectory())
+					{
+						Add(FileEventType::Modified, std::move(path), false);
+					}
+					break;
+				case FILE_ACTION_RENAMED_OLD_NAME:
+					renamedFrom = std::move(path);
+					break;
+				case FILE_ACTION_RENAMED_NEW_NAME:
+				{
+					const bool isDirectory = PathStruct(path).IsDirectory();
+					if (renamedFrom.empty())
+					{
+						Add(FileEventType::Created, std::move(path), isDirectory);
+					}
+					else
+					{
+						Add(FileEventType::Moved, std::move(path), isDirectory, std::move(renamedFrom));
+						renamedFrom.clear();
+					}
+					break;
+				}
+				}
+
+				if (info->NextEntryOffset == 0)
+				{
+					break;
+				}
+				position += info->NextEntryOffset;
+			}
+		}
+#else
+		bool OpenNative() { return false; }
+		void CloseNative() {}
+		void WaitNative(std::chrono::milliseconds) {}
+#endif
+	};
+}
\ No newline at end of file
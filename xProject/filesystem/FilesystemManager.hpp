@@ -2,6 +2,7 @@
 
 #include "xProject_pch.hpp"
 
+#include "DirectoryWalker.hpp"
 #include "PathStruct.hpp"
 
 namespace FileS
@@ -31,14 +32,23 @@ namespace FileS
             return SetCurrentDirectoryW(_path.GetPathW().c_str());
         }
 
+		// Both stat the path on every call, the metadata cached in _path may be stale
 		static bool DirectoryExists(const PathStruct& _path)
         {
-            return PathIsDirectoryW(_path.GetPathW().c_str());
+            return _path.CurrentMetadata().isDirectory;
         }
 
 		static bool FileExists(const PathStruct& _path)
         {
-            return !_path.IsDirectory() && PathFileExistsW(_path.GetPathW().c_str());
+            const FileMetadata metadata = _path.CurrentMetadata();
+            return metadata.exists && !metadata.isDirectory;
+        }
+
+		// Recursive listing of _root fanned out over _threadPool, see DirectoryWalker
+		static WalkResult WalkDirectory(const PathStruct& _root, Pool::ThreadPool& _threadPool, DirectoryWalker::EntryCallback _onEntry,
+										const WalkOptions& _options = WalkOptions())
+        {
+            return DirectoryWalker(_threadPool, _options).Walk(_root, std::move(_onEntry));
         }
 	};
 }
\ No newline at end of file
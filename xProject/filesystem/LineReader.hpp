@@ -0,0 +1,377 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <bit>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <intrin.h>
+#define XPROJECT_HAS_SSE2 1
+#define XPROJECT_HAS_AVX2_DISPATCH 1
+#define XPROJECT_TARGET_AVX2
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define XPROJECT_HAS_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XPROJECT_HAS_AVX2_DISPATCH 1
+#define XPROJECT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#include "FileIO.hpp"
+
+namespace FileS
+{
+
+	namespace Detail
+	{
+#ifdef XPROJECT_HAS_AVX2_DISPATCH
+		inline bool CpuHasAvx2()
+		{
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			// The OS must save the YMM registers on a context switch
+			const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+			__cpuidex(info, 7, 0);
+			return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+
+		// 64 bytes a round, the two compares are folded into one branch
+		XPROJECT_TARGET_AVX2 inline const char* FindByteAvx2(const char* _begin, const char* _end, char _byte)
+		{
+			const __m256i needle = _mm256_set1_epi8(_byte);
+			while (_end - _begin >= 64)
+			{
+				const __m256i low = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_begin)), needle);
+				const __m256i high = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_begin + 32)), needle);
+				if (!_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high)))
+				{
+					const std::uint64_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(low)) |
+						(static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(high))) << 32);
+					return _begin + std::countr_zero(mask);
+				}
+				_begin += 64;
+			}
+			if (_end - _begin >= 32)
+			{
+				const std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+					_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_begin)), needle)));
+				if (mask != 0)
+				{
+					return _begin + std::countr_zero(mask);
+				}
+				_begin += 32;
+			}
+			return _begin;
+		}
+#endif
+
+#ifdef XPROJECT_HAS_SSE2
+		inline const char* FindByteSse2(const char* _begin, const char* _end, char _byte)
+		{
+			const __m128i needle = _mm_set1_epi8(_byte);
+			while (_end - _begin >= 16)
+			{
+				const std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(
+					_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_begin)), needle)));
+				if (mask != 0)
+				{
+					return _begin + std::countr_zero(mask);
+				}
+				_begin += 16;
+			}
+			return _begin;
+		}
+#endif
+	}
+
+	/// First _byte in [_begin, _end), _end when there is none. AVX2 is picked at run
+	/// time where the CPU has it, SSE2 otherwise, the last bytes go through memchr.
+	inline const char* FindByte(const char* _begin, const char* _end, char _byte)
+	{
+#ifdef XPROJECT_HAS_AVX2_DISPATCH
+		static const bool hasAvx2 = Detail::CpuHasAvx2();
+		if (hasAvx2)
+		{
+			_begin = Detail::FindByteAvx2(_begin, _end, _byte);
+			if (_begin != _end && *_begin == _byte)
+			{
+				return _begin;
+			}
+		}
+#endif
+#ifdef XPROJECT_HAS_SSE2
+		_begin = Detail::FindByteSse2(_begin, _end, _byte);
+		if (_begin != _end && *_begin == _byte)
+		{
+			return _begin;
+		}
+#endif
+		const void* found = std::memchr(_begin, static_cast<unsigned char>(_byte), static_cast<std::size_t>(_end - _begin));
+		return found != nullptr ? static_cast<const char*>(found) : _end;
+	}
+
+	/// StreamBuffer
+	/// ------------------------------------------------------------
+	/// Large read buffer over a FileIO opened for binary input. Bytes are handed out in
+	/// place, only an unfinished tail is moved to the front when the end of the buffer is
+	/// reached, and the buffer doubles when a single item does not fit.
+	class StreamBuffer
+	{
+	private:
+		FileIO& file;
+		std::vector<char> buffer;
+		std::size_t begin = 0;
+		std::size_t end = 0;
+		// File offset of the first available byte
+		std::uint64_t offset = 0;
+		bool eof = false;
+
+	public:
+		static constexpr std::size_t kDefaultSize = 1024 * 1024;
+
+		explicit StreamBuffer(FileIO& _file, std::size_t _size = kDefaultSize)
+			: file(_file), buffer(std::max<std::size_t>(_size, 64)) {}
+
+		const char* Data() const
+		{
+			return buffer.data() + begin;
+		}
+
+		std::size_t Available() const
+		{
+			return end - begin;
+		}
+
+		std::uint64_t Offset() const
+		{
+			return offset;
+		}
+
+		bool AtEnd() const
+		{
+			return eof && begin == end;
+		}
+
+		void Consume(std::size_t _count)
+		{
+			begin += _count;
+			offset += _count;
+		}
+
+		// Reads more behind the available bytes, which may move them. False at end of file.
+		bool Fill()
+		{
+			if (eof)
+			{
+				return false;
+			}
+
+			if (end == buffer.size())
+			{
+				if (begin == 0)
+				{
+					buffer.resize(buffer.size() * 2);
+				}
+				else
+				{
+					std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+					end -= begin;
+					begin = 0;
+				}
+			}
+
+			const std::size_t wanted = buffer.size() - end;
+			const std::streamsize read = file.Read(buffer.data() + end, static_cast<std::streamsize>(wanted)).gcount();
+			if (read <= 0)
+			{
+				eof = true;
+				return false;
+			}
+
+			end += static_cast<std::size_t>(read);
+			if (static_cast<std::size_t>(read) < wanted)
+			{
+				eof = true;
+			}
+			return true;
+		}
+	};
+
+	/// LineReader
+	/// ------------------------------------------------------------
+	/// Splits a file into lines straight from a StreamBuffer. With the default '\n'
+	/// delimiter a trailing '\r' is dropped as well, the last line needs no delimiter.
+	class LineReader
+	{
+	private:
+		StreamBuffer buffer;
+		char delimiter;
+		// Bytes already searched, kept across a Fill so they are not scanned twice
+		std::size_t scanned = 0;
+		std::uint64_t lines = 0;
+
+	public:
+		explicit LineReader(FileIO& _file, char _delimiter = '\n', std::size_t _bufferSize = StreamBuffer::kDefaultSize)
+			: buffer(_file, _bufferSize), delimiter(_delimiter) {}
+
+		/// The next line without its delimiter, valid until the following call. False at
+		/// end of file.
+		bool Next(std::string_view& _line)
+		{
+			while (true)
+			{
+				const char* data = buffer.Data();
+				const std::size_t available = buffer.Available();
+
+				const char* found = FindByte(data + scanned, data + available, delimiter);
+				if (found != data + available)
+				{
+					const std::size_t length = static_cast<std::size_t>(found - data);
+					_line = Trim(std::string_view(data, length));
+					buffer.Consume(length + 1);
+					break;
+				}
+
+				scanned = available;
+				if (!buffer.Fill())
+				{
+					if (available == 0)
+					{
+						return false;
+					}
+					_line = Trim(std::string_view(buffer.Data(), available));
+					buffer.Consume(available);
+					break;
+				}
+			}
+
+			scanned = 0;
+			lines++;
+			return true;
+		}
+
+		std::uint64_t LineCount() const
+		{
+			return lines;
+		}
+
+		// File offset of the next line
+		std::uint64_t Offset() const
+		{
+			return buffer.Offset();
+		}
+
+	private:
+		std::string_view Trim(std::string_view _line) const
+		{
+			if (delimiter == '\n' && !_line.empty() && _line.back() == '\r')
+			{
+				_line.remove_suffix(1);
+			}
+			return _line;
+		}
+	};
+
+	/// RecordReader
+	/// ------------------------------------------------------------
+	/// Reads records framed by a 4-byte little-endian length, as WriteRecord writes them.
+	/// A length above the limit marks the file corrupt, a record cut off by the end of
+	/// the file marks it truncated, Next returns false in both cases.
+	class RecordReader
+	{
+	private:
+		StreamBuffer buffer;
+		std::size_t maxRecordSize;
+		std::uint64_t records = 0;
+		bool corrupt = false;
+		bool truncated = false;
+
+	public:
+		static constexpr std::size_t kHeaderSize = 4;
+
+		explicit RecordReader(FileIO& _file, std::size_t _maxRecordSize = 64 * 1024 * 1024, std::size_t _bufferSize = StreamBuffer::kDefaultSize)
+			: buffer(_file, _bufferSize), maxRecordSize(_maxRecordSize) {}
+
+		// The next record's payload, valid until the following call
+		bool Next(std::string_view& _record)
+		{
+			if (corrupt || truncated || !Require(kHeaderSize))
+			{
+				return false;
+			}
+
+			const unsigned char* header = reinterpret_cast<const unsigned char*>(buffer.Data());
+			const std::size_t length = static_cast<std::size_t>(header[0]) | (static_cast<std::size_t>(header[1]) << 8) |
+				(static_cast<std::size_t>(header[2]) << 16) | (static_cast<std::size_t>(header[3]) << 24);
+			if (length > maxRecordSize)
+			{
+				corrupt = true;
+				return false;
+			}
+
+			if (!Require(kHeaderSize + length))
+			{
+				return false;
+			}
+
+			_record = std::string_view(buffer.Data() + kHeaderSize, length);
+			buffer.Consume(kHeaderSize + length);
+			records++;
+			return true;
+		}
+
+		std::uint64_t RecordCount() const
+		{
+			return records;
+		}
+
+		// File offset of the next record, where a writer resumes after a truncated tail
+		std::uint64_t Offset() const
+		{
+			return buffer.Offset();
+		}
+
+		bool IsCorrupt() const
+		{
+			return corrupt;
+		}
+
+		bool IsTruncated() const
+		{
+			return truncated;
+		}
+
+	private:
+		bool Require(std::size_t _bytes)
+		{
+			while (buffer.Available() < _bytes)
+			{
+				if (!buffer.Fill())
+				{
+					truncated = buffer.Available() != 0;
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	// Appends _record in the framing RecordReader reads
+	inline bool WriteRecord(FileIO& _file, std::string_view _record)
+	{
+		const std::uint32_t length = static_cast<std::uint32_t>(_record.size());
+		const char header[RecordReader::kHeaderSize] = {
+			static_cast<char>(length & 0xFF), static_cast<char>((length >> 8) & 0xFF),
+			static_cast<char>((length >> 16) & 0xFF), static_cast<char>((length >> 24) & 0xFF)
+		};
+		return _file.Write(header, sizeof(header)) && _file.Write(_record.data(), static_cast<std::streamsize>(_record.size()));
+	}
+}
\ No newline at end of file
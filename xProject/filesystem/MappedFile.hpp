@@ -0,0 +1,320 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <span>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "PathStruct.hpp"
+
+namespace FileS
+{
+
+	enum class MapMode
+	{
+		ReadOnly,
+		// Shared with the file, stores reach it without a write call
+		ReadWrite
+	};
+
+	enum class AccessHint
+	{
+		Normal,
+		// Aggressive read-ahead, pages behind the reader may be dropped early
+		Sequential,
+		// No read-ahead
+		Random,
+		// Starts reading the range in now
+		WillNeed,
+		// The range is not needed soon, its pages may be reclaimed
+		DontNeed
+	};
+
+	/// MappedFile
+	/// ------------------------------------------------------------
+	/// Maps a whole file into the address space. Reads are served from the page cache
+	/// without copying into a caller buffer, the spans stay valid until Close.
+	class MappedFile
+	{
+	private:
+#ifdef _WIN32
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		HANDLE mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+		char* data = nullptr;
+		std::size_t size = 0;
+		MapMode mode = MapMode::ReadOnly;
+
+	public:
+		MappedFile() = default;
+		MappedFile(const PathStruct& _path, MapMode _mode, AccessHint _hint = AccessHint::Normal)
+		{
+			Open(_path, _mode, _hint);
+		}
+
+		~MappedFile() { Close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& _other) noexcept { Swap(_other); }
+		MappedFile& operator=(MappedFile&& _other) noexcept
+		{
+			if (this != &_other)
+			{
+				Close();
+				Swap(_other);
+			}
+			return *this;
+		}
+
+		/// With ReadWrite and a non-zero _size the file is created if missing and resized
+		/// to _size before mapping, which is how a file is mapped for writing from scratch
+		bool Open(const PathStruct& _path, MapMode _mode, AccessHint _hint = AccessHint::Normal, std::size_t _size = 0)
+		{
+			Close();
+			mode = _mode;
+
+			if (!OpenFile(_path, _hint, _size) || !MapFile())
+			{
+				Close();
+				return false;
+			}
+
+			if (_hint != AccessHint::Normal)
+			{
+				Advise(_hint);
+			}
+			return true;
+		}
+
+		void Close()
+		{
+#ifdef _WIN32
+			if (data != nullptr)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mappingHandle != nullptr)
+			{
+				CloseHandle(mappingHandle);
+				mappingHandle = nullptr;
+			}
+			if (fileHandle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(fileHandle);
+				fileHandle = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (data != nullptr)
+			{
+				munmap(data, size);
+			}
+			if (fileDescriptor != -1)
+			{
+				close(fileDescriptor);
+				fileDescriptor = -1;
+			}
+#endif
+			data = nullptr;
+			size = 0;
+		}
+
+		bool IsOpen() const
+		{
+#ifdef _WIN32
+			return fileHandle != INVALID_HANDLE_VALUE;
+#else
+			return fileDescriptor != -1;
+#endif
+		}
+
+		std::size_t Size() const { return size; }
+
+		std::span<const char> Data() const { return { data, size }; }
+
+		// Empty for a read-only map
+		std::span<char> MutableData() { return mode == MapMode::ReadWrite ? std::span<char>(data, size) : std::span<char>(); }
+
+		// Clamped to the end of the file
+		std::span<const char> Span(std::size_t _offset, std::size_t _length) const
+		{
+			if (_offset >= size)
+			{
+				return {};
+			}
+			return { data + _offset, std::min(_length, size - _offset) };
+		}
+
+		/// Hints the expected access to [_offset, _offset + _length), a zero _length means to
+		/// the end. Windows has no per-range hints for mapped files: Sequential and Random
+		/// only take effect through Open, WillNeed prefetches and DontNeed does nothing.
+		bool Advise(AccessHint _hint, std::size_t _offset = 0, std::size_t _length = 0)
+		{
+			if (data == nullptr || _offset >= size)
+			{
+				return false;
+			}
+			if (_length == 0 || _length > size - _offset)
+			{
+				_length = size - _offset;
+			}
+
+#ifdef _WIN32
+			if (_hint == AccessHint::WillNeed)
+			{
+				WIN32_MEMORY_RANGE_ENTRY range{ data + _offset, _length };
+				return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+			}
+			return true;
+#else
+			// madvise wants a page aligned start
+			static const std::size_t pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+			const std::size_t alignedOffset = _offset - _offset % pageSize;
+
+			int advice = MADV_NORMAL;
+			switch (_hint)
+			{
+			case AccessHint::Normal:     advice = MADV_NORMAL; break;
+			case AccessHint::Sequential: advice = MADV_SEQUENTIAL; break;
+			case AccessHint::Random:     advice = MADV_RANDOM; break;
+			case AccessHint::WillNeed:   advice = MADV_WILLNEED; break;
+			case AccessHint::DontNeed:   advice = MADV_DONTNEED; break;
+			}
+			return madvise(data + alignedOffset, _length + (_offset - alignedOffset), advice) == 0;
+#endif
+		}
+
+		// Writes dirty pages of a ReadWrite map to disk and waits for them
+		bool Flush()
+		{
+			if (data == nullptr)
+			{
+				return IsOpen();
+			}
+
+#ifdef _WIN32
+			return FlushViewOfFile(data, 0) && FlushFileBuffers(fileHandle);
+#else
+			return msync(data, size, MS_SYNC) == 0;
+#endif
+		}
+
+	private:
+		bool OpenFile(const PathStruct& _path, AccessHint _hint, std::size_t _size)
+		{
+			const bool writable = mode == MapMode::ReadWrite;
+			const bool create = writable && _size > 0;
+
+#ifdef _WIN32
+			DWORD flags = FILE_ATTRIBUTE_NORMAL;
+			if (_hint == AccessHint::Sequential)
+			{
+				flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+			}
+			else if (_hint == AccessHint::Random)
+			{
+				flags |= FILE_FLAG_RANDOM_ACCESS;
+			}
+
+			// Shared for writing in both modes, FileIO may hold the same file open through its fstream
+			fileHandle = CreateFileW(_path.GetPathW().c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+				FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+				create ? OPEN_ALWAYS : OPEN_EXISTING, flags, nullptr);
+			if (fileHandle == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			if (create)
+			{
+				LARGE_INTEGER newSize;
+				newSize.QuadPart = static_cast<LONGLONG>(_size);
+				if (!SetFilePointerEx(fileHandle, newSize, nullptr, FILE_BEGIN) || !SetEndOfFile(fileHandle))
+				{
+					return false;
+				}
+			}
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(fileHandle, &fileSize))
+			{
+				return false;
+			}
+			size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+			fileDescriptor = open(_path.GetPath().c_str(), (writable ? O_RDWR : O_RDONLY) | (create ? O_CREAT : 0) | O_CLOEXEC, 0644);
+			if (fileDescriptor == -1)
+			{
+				return false;
+			}
+
+			if (create && ftruncate(fileDescriptor, static_cast<off_t>(_size)) != 0)
+			{
+				return false;
+			}
+
+			struct stat fileStat;
+			if (fstat(fileDescriptor, &fileStat) != 0)
+			{
+				return false;
+			}
+			size = static_cast<std::size_t>(fileStat.st_size);
+#endif
+			return true;
+		}
+
+		bool MapFile()
+		{
+			// An empty file cannot be mapped, it stays open with empty spans
+			if (size == 0)
+			{
+				return true;
+			}
+
+			const bool writable = mode == MapMode::ReadWrite;
+
+#ifdef _WIN32
+			mappingHandle = CreateFileMappingW(fileHandle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+			if (mappingHandle == nullptr)
+			{
+				return false;
+			}
+
+			data = static_cast<char*>(MapViewOfFile(mappingHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+			return data != nullptr;
+#else
+			void* mapped = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fileDescriptor, 0);
+			if (mapped == MAP_FAILED)
+			{
+				return false;
+			}
+
+			data = static_cast<char*>(mapped);
+			return true;
+#endif
+		}
+
+		void Swap(MappedFile& _other) noexcept
+		{
+#ifdef _WIN32
+			std::swap(fileHandle, _other.fileHandle);
+			std::swap(mappingHandle, _other.mappingHandle);
+#else
+			std::swap(fileDescriptor, _other.fileDescriptor);
+#endif
+			std::swap(data, _other.data);
+			std::swap(size, _other.size);
+			std::swap(mode, _other.mode);
+		}
+	};
+}
\ No newline at end of file
@@ -2,28 +2,198 @@
 
 #include "xProject_pch.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <iterator>
+#include <string_view>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 #include "utils/Utils.hpp"
 
 namespace FileS
 {
 
+	/// What one stat of a path found
+	struct FileMetadata
+	{
+		bool exists = false;
+		bool isDirectory = false;
+		std::uint64_t size = 0;
+		std::chrono::system_clock::time_point lastWriteTime{};
+	};
+
 	const char kPathSeparator = '/';
 
+#ifdef _WIN32
+	// Windows takes either, Normalize turns '\\' into kPathSeparator
+	static bool IsPathSeparator(const char& c) { return c == kPathSeparator || c == '\\'; }
+#else
 	static bool IsPathSeparator(const char& c) { return c == kPathSeparator; }
+#endif
+
+	namespace Detail
+	{
+		/// Value built on the first Get(), also when several threads call it at once: each
+		/// may build one, the first stored wins and the others are discarded
+		template<typename TypeVal>
+		class LazyValue
+		{
+		private:
+			mutable std::atomic<TypeVal*> value = nullptr;
+
+		public:
+			LazyValue() = default;
+			LazyValue(const LazyValue& _other) : value(_other.Copy()) {}
+			LazyValue(LazyValue&& _other) noexcept : value(_other.value.exchange(nullptr)) {}
+
+			LazyValue& operator=(const LazyValue& _other)
+			{
+				if (this != &_other)
+				{
+					delete value.exchange(_other.Copy());
+				}
+				return *this;
+			}
+
+			LazyValue& operator=(LazyValue&& _other) noexcept
+			{
+				if (this != &_other)
+				{
+					delete value.exchange(_other.value.exchange(nullptr));
+				}
+				return *this;
+			}
+
+			~LazyValue() { Reset(); }
+
+			template<typename Make>
+			const TypeVal& Get(Make&& _make) const
+			{
+				TypeVal* current = value.load(std::memory_order_acquire);
+				if (current == nullptr)
+				{
+					TypeVal* created = new TypeVal(_make());
+					if (value.compare_exchange_strong(current, created, std::memory_order_acq_rel, std::memory_order_acquire))
+					{
+						current = created;
+					}
+					else
+					{
+						delete created;
+					}
+				}
+				return *current;
+			}
+
+			// Not safe against a concurrent Get(), like any other change of the owner
+			void Reset()
+			{
+				delete value.exchange(nullptr);
+			}
+
+		private:
+			TypeVal* Copy() const
+			{
+				const TypeVal* current = value.load(std::memory_order_acquire);
+				return current ? new TypeVal(*current) : nullptr;
+			}
+		};
+	}
 
+	/// PathStruct
+	/// ------------------------------------------------------------
+	/// Normalized UTF-8 path in one string, short paths stay in its inline buffer.
+	/// The component accessors return views into it and allocate nothing, the wide form
+	/// the Win32 calls need is converted on first use only.
 	class PathStruct
 	{
 	private:
 		std::string path;
-		std::wstring pathW;
-		std::size_t fileLength = 0;
+		// Loaded on first use, constructing a path neither converts nor touches a file. Safe
+		// to fill from const calls on several threads at once.
+		Detail::LazyValue<std::wstring> pathW;
+		Detail::LazyValue<FileMetadata> metadata;
 
 	public:
-		explicit PathStruct(const std::string& _path) : path(_path)
+		/// ComponentIterator
+		/// ------------------------------------------------------------
+		/// Walks the names between separators, a leading "/" or "//" is not a component
+		class ComponentIterator
+		{
+		private:
+			std::string_view path;
+			std::size_t begin = 0;
+			std::size_t end = 0;
+
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = std::string_view;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const std::string_view*;
+			using reference = std::string_view;
+
+			ComponentIterator() = default;
+			ComponentIterator(std::string_view _path, std::size_t _begin) : path(_path), begin(_begin)
+			{
+				Settle();
+			}
+
+			std::string_view operator*() const { return path.substr(begin, end - begin); }
+
+			ComponentIterator& operator++()
+			{
+				begin = end;
+				Settle();
+				return *this;
+			}
+
+			ComponentIterator operator++(int)
+			{
+				ComponentIterator previous = *this;
+				++(*this);
+				return previous;
+			}
+
+			bool operator==(const ComponentIterator& _other) const { return begin == _other.begin; }
+			bool operator!=(const ComponentIterator& _other) const { return begin != _other.begin; }
+
+		private:
+			void Settle()
+			{
+				while (begin < path.size() && IsPathSeparator(path[begin]))
+				{
+					begin++;
+				}
+
+				end = path.find(kPathSeparator, begin);
+				if (end == std::string_view::npos)
+				{
+					end = path.size();
+				}
+			}
+		};
+
+		struct ComponentRange
+		{
+			ComponentIterator first;
+			ComponentIterator last;
+
+			ComponentIterator begin() const { return first; }
+			ComponentIterator end() const { return last; }
+		};
+
+		PathStruct() = default;
+		explicit PathStruct(std::string _path) : path(std::move(_path))
 		{
-			pathW.resize(path.size());
 			PathProcessing();
 		}
+		explicit PathStruct(std::string_view _path) : PathStruct(std::string(_path)) {}
+		explicit PathStruct(const char* _path) : PathStruct(std::string(_path)) {}
 
 		~PathStruct() = default;
 
@@ -32,78 +202,252 @@ namespace FileS
 			return path;
 		}
 
-		void SetPath(const char* _path)
+		std::string_view View() const
+		{
+			return path;
+		}
+
+		void SetPath(std::string_view _path)
 		{
-			path = _path;
+			path.assign(_path);
 			PathProcessing();
 		}
 
+		// UTF-16 form for the wide Win32 calls, converted on the first call. Uses '\\' on
+		// Windows, the Path* functions and "\\\\?\\" prefixes do not accept '/'.
 		const std::wstring& GetPathW() const
 		{
-			return pathW;
+			return pathW.Get(
+				[this]()
+				{
+					std::wstring wide = ToWide(path);
+#ifdef _WIN32
+					std::replace(wide.begin(), wide.end(), L'/', L'\\');
+#endif
+					return wide;
+				}
+			);
 		}
 
-		const std::size_t& GetFileLenght() const
+		std::size_t GetFileLenght() const
 		{
-			return fileLength;
+			return static_cast<std::size_t>(Metadata().size);
 		}
 
-		std::string GetPathFileName() const
+		/// Stats the path on the first call and answers from the cache afterwards
+		const FileMetadata& Metadata() const
 		{
-			if (!IsDirectory())
+			return metadata.Get([this]() { return LoadMetadata(); });
+		}
+
+		// The next query stats the path again
+		void RefreshMetadata()
+		{
+			metadata.Reset();
+		}
+
+		// Stats the path now, the cache is neither used nor updated
+		FileMetadata CurrentMetadata() const
+		{
+			return LoadMetadata();
+		}
+
+		bool Exists() const
+		{
+			return Metadata().exists;
+		}
+
+		ComponentRange Components() const
+		{
+			const std::string_view view = path;
+			return { ComponentIterator(view, 0), ComponentIterator(view, view.size()) };
+		}
+
+		// Last component, empty for a path ending in a separator
+		std::string_view FileName() const
+		{
+			const std::size_t separator = path.rfind(kPathSeparator);
+			return separator == std::string::npos ? View() : View().substr(separator + 1);
+		}
+
+		// Extension with its dot, empty for "name" and for dot files such as ".config"
+		std::string_view Extension() const
+		{
+			const std::string_view fileName = FileName();
+			const std::size_t dot = fileName.rfind('.');
+			if (dot == std::string_view::npos || dot == 0 || fileName == "..")
+			{
+				return {};
+			}
+			return fileName.substr(dot);
+		}
+
+		std::string_view Stem() const
+		{
+			const std::string_view fileName = FileName();
+			return fileName.substr(0, fileName.size() - Extension().size());
+		}
+
+		// Everything before the last component, the root stays a root
+		std::string_view ParentView() const
+		{
+			const std::size_t separator = path.rfind(kPathSeparator);
+			if (separator == std::string::npos)
+			{
+				return {};
+			}
+
+			std::size_t rootLength = 0;
+			while (rootLength < path.size() && IsPathSeparator(path[rootLength]))
+			{
+				rootLength++;
+			}
+			return View().substr(0, std::max(separator, rootLength));
+		}
+
+		PathStruct Parent() const
+		{
+			return PathStruct(ParentView());
+		}
+
+		/// Appends _component after a separator, in place. An absolute _component replaces
+		/// the path the way std::filesystem does.
+		PathStruct& Append(std::string_view _component)
+		{
+			if (_component.empty())
+			{
+				return *this;
+			}
+
+			if (IsPathSeparator(_component.front()) || path.empty())
+			{
+				path.assign(_component);
+			}
+			else
 			{
-				const std::wstring fileNameW = PathFindFileNameW(pathW.c_str());
+				if (!IsPathSeparator(path.back()))
+				{
+					path.push_back(kPathSeparator);
+				}
+				path.append(_component);
+			}
+
+			PathProcessing();
+			return *this;
+		}
 
-				std::string fileNameA;
-				fileNameA.resize(fileNameW.size());
+		PathStruct& operator/=(std::string_view _component)
+		{
+			return Append(_component);
+		}
+
+		PathStruct operator/(std::string_view _component) const
+		{
+			PathStruct joined(*this);
+			joined.Append(_component);
+			return joined;
+		}
 
-				Utils::ConvertUNICODEtoUTF8(fileNameA.data(), fileNameW.c_str(), MAX_PATH);
+		bool operator==(const PathStruct& _other) const
+		{
+			return path == _other.path;
+		}
 
-				return fileNameA;
+		std::string GetPathFileName() const
+		{
+			if (!IsDirectory())
+			{
+				return std::string(FileName());
 			}
 			return "";
 		}
 
 		bool IsAbsolutePath() const
 		{
-			return !PathIsRelativeW(pathW.c_str());
+			if (!path.empty() && IsPathSeparator(path.front()))
+			{
+				return true;
+			}
+			// Drive letter, as in "C:/", a "C:\" was normalized to it
+			return path.size() >= 3 && std::isalpha(static_cast<unsigned char>(path[0])) && path[1] == ':' &&
+				IsPathSeparator(path[2]);
 		}
 
+		// Asks the file system every time, unlike Metadata().isDirectory
 		bool IsDirectory() const
 		{
-			return PathIsDirectoryW(pathW.c_str());
+			return CurrentMetadata().isDirectory;
 		}
 
 		bool IsRootDirectory() const
 		{
-			return PathIsRootW(pathW.c_str());
+#ifdef _WIN32
+			return PathIsRootW(GetPathW().c_str());
+#else
+			return path == "/";
+#endif
 		}
 	private:
 		void PathProcessing()
 		{
-			Utils::ConvertUTF8toUNOCODE(pathW.data(), path.c_str(), path.size());
-
 			Normalize();
-			GettingFileLength();
+			pathW.Reset();
+			metadata.Reset();
 		}
 
-		void GettingFileLength()
+		static std::wstring ToWide(const std::string& _utf8)
 		{
-			HANDLE hFile = CreateFileW(pathW.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-			if (hFile == INVALID_HANDLE_VALUE)
+			std::wstring wide;
+#ifdef _WIN32
+			if (_utf8.empty())
 			{
-				return;
+				return wide;
 			}
 
-			LARGE_INTEGER fileSize;
-			if (!GetFileSizeEx(hFile, &fileSize))
+			const int length = MultiByteToWideChar(CP_UTF8, 0, _utf8.data(), static_cast<int>(_utf8.size()), nullptr, 0);
+			wide.resize(static_cast<std::size_t>(length));
+			MultiByteToWideChar(CP_UTF8, 0, _utf8.data(), static_cast<int>(_utf8.size()), wide.data(), length);
+#else
+			// Only used on Windows, a plain widening keeps ASCII paths intact elsewhere
+			wide.assign(_utf8.begin(), _utf8.end());
+#endif
+			return wide;
+		}
+
+		// Attribute query only, no handle is opened
+		FileMetadata LoadMetadata() const
+		{
+			FileMetadata result;
+#ifdef _WIN32
+			WIN32_FILE_ATTRIBUTE_DATA attributes;
+			if (!GetFileAttributesExW(GetPathW().c_str(), GetFileExInfoStandard, &attributes))
 			{
-				return;
+				return result;
 			}
 
-			fileLength = fileSize.QuadPart;
+			result.exists = true;
+			result.isDirectory = (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			result.size = (static_cast<std::uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+
+			// FILETIME counts 100 ns intervals since 1601-01-01
+			constexpr std::uint64_t kUnixEpochFileTime = 116444736000000000ull;
+			const std::uint64_t fileTime = (static_cast<std::uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+			result.lastWriteTime = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+				std::chrono::nanoseconds((static_cast<std::int64_t>(fileTime) - static_cast<std::int64_t>(kUnixEpochFileTime)) * 100)));
+#else
+			struct stat fileStat;
+			if (stat(path.c_str(), &fileStat) != 0)
+			{
+				return result;
+			}
 
-			CloseHandle(hFile);
+			result.exists = true;
+			result.isDirectory = S_ISDIR(fileStat.st_mode);
+			result.size = S_ISREG(fileStat.st_mode) ? static_cast<std::uint64_t>(fileStat.st_size) : 0;
+			result.lastWriteTime = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+				std::chrono::seconds(fileStat.st_mtim.tv_sec) + std::chrono::nanoseconds(fileStat.st_mtim.tv_nsec)));
+#endif
+			return result;
 		}
 
 		void Normalize()
@@ -0,0 +1,747 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "DirectoryWalker.hpp"
+#include "FileIO.hpp"
+#include "LineReader.hpp"
+#include "PathStruct.hpp"
+#include "utils/Checksum.hpp"
+#include "utils/ThreadPool.hpp"
+
+namespace FileS
+{
+
+	struct WalOptions
+	{
+		// A segment is closed once it grows past this, a batch is never split across two
+		std::uint64_t segmentSize = 64 * 1024 * 1024;
+		// Sync every batch to the device, without it an append only survives a process crash
+		bool sync = true;
+		// The leader waits this long for more appends before writing, with 0 a batch holds
+		// whatever arrived while the previous one was syncing
+		std::chrono::microseconds commitDelay{ 0 };
+		std::size_t maxRecordSize = 16 * 1024 * 1024;
+	};
+
+	/// WriteAheadLog
+	/// ------------------------------------------------------------
+	/// Append-only journal in a directory of segment files, each named after the sequence
+	/// number of its first record. A record is a 16-byte header followed by the payload:
+	///     [crc32c:4][length:4][lsn:8][payload:length], little-endian
+	/// The checksum is CRC-32C of the payload continued over the length and LSN.
+	///
+	/// Group commit: an appender whose record is not durable yet and finds no write in
+	/// progress becomes the leader. It takes every record queued so far, writes them with
+	/// one call and one sync, then wakes the others. Appends arriving meanwhile form the
+	/// next batch, so the sync cost is shared by all threads waiting on it.
+	///
+	/// Open scans the segments, cuts a torn tail off the last one and continues after the
+	/// last valid record. A failed write or sync fails the log: every later append
+	/// returns false until it is opened again.
+	class WriteAheadLog
+	{
+	public:
+		using ReplayCallback = std::function<void(std::uint64_t, std::string_view)>;
+
+		static constexpr std::size_t kHeaderSize = 16;
+
+	private:
+		struct Segment
+		{
+			std::uint64_t firstLsn = 0;
+			std::string path;
+		};
+
+		enum class ScanEnd
+		{
+			// Reached the end of the file after a whole record
+			Clean,
+			// Stopped at a record that is cut off, fails its checksum or breaks the sequence
+			Damaged,
+			// The file could not be opened or read to its end, says nothing about the records
+			Unreadable
+		};
+
+		struct ScanResult
+		{
+			std::uint64_t validBytes = 0;
+			std::uint64_t records = 0;
+			ScanEnd end = ScanEnd::Clean;
+		};
+
+		WalOptions options;
+		std::string directory;
+
+		// Guards the batch being collected and the sequence numbers
+		mutable std::mutex mutex;
+		std::condition_variable committed;
+		std::vector<char> pending;
+		std::uint64_t pendingFirstLsn = 0;
+		std::uint64_t nextLsn = 1;
+		std::uint64_t durableLsn = 0;
+		std::uint64_t batches = 0;
+		bool flushing = false;
+		bool failed = false;
+		bool open = false;
+
+		// Owned by the leader while flushing is set
+		std::vector<char> writing;
+#ifdef _WIN32
+		HANDLE segmentHandle = INVALID_HANDLE_VALUE;
+#else
+		int segmentFd = -1;
+#endif
+		std::uint64_t segmentBytes = 0;
+
+		// The leader adds segments, Replay and RemoveBefore read them
+		mutable std::mutex segmentsMutex;
+		std::vector<Segment> segments;
+
+	public:
+		WriteAheadLog() = default;
+		~WriteAheadLog() { Close(); }
+
+		WriteAheadLog(const WriteAheadLog&) = delete;
+		WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+		/// Creates _directory if needed and recovers the existing segments. Fails on a
+		/// damaged record anywhere but at the end of the last segment, and on a segment
+		/// that cannot be read, which is never truncated.
+		bool Open(const PathStruct& _directory, WalOptions _options = WalOptions())
+		{
+			Close();
+
+			options = std::move(_options);
+			directory = _directory.GetPath();
+			if (!EnsureDirectory())
+			{
+				return false;
+			}
+
+			std::vector<Segment> found = ListSegments();
+			std::uint64_t expectedLsn = found.empty() ? 1 : found.front().firstLsn;
+			ScanResult last;
+
+			for (std::size_t i = 0; i < found.size(); i++)
+			{
+				if (found[i].firstLsn != expectedLsn)
+				{
+					return false;
+				}
+
+				last = Scan(found[i], 0, nullptr);
+				if (last.end == ScanEnd::Unreadable)
+				{
+					return false;
+				}
+				if (last.end == ScanEnd::Damaged)
+				{
+					if (i + 1 != found.size() || !TruncateFile(found[i].path, last.validBytes))
+					{
+						return false;
+					}
+				}
+				expectedLsn = found[i].firstLsn + last.records;
+			}
+
+			if (!found.empty() && !OpenSegment(found.back().path))
+			{
+				return false;
+			}
+			segmentBytes = last.validBytes;
+
+			{
+				std::lock_guard<std::mutex> lock(segmentsMutex);
+				segments = std::move(found);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			nextLsn = expectedLsn;
+			durableLsn = expectedLsn - 1;
+			failed = false;
+			open = true;
+			return true;
+		}
+
+		// Commits what is still queued, appends racing with Close may fail
+		void Close()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!open)
+			{
+				return;
+			}
+
+			// Appends that slip in while a batch is written join the next one
+			while (flushing || (!pending.empty() && !failed))
+			{
+				if (flushing)
+				{
+					committed.wait(lock);
+				}
+				else
+				{
+					CommitPending(lock);
+				}
+			}
+			open = false;
+			committed.notify_all();
+			lock.unlock();
+
+			CloseSegment();
+			std::lock_guard<std::mutex> segmentsLock(segmentsMutex);
+			segments.clear();
+		}
+
+		bool IsOpen() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return open && !failed;
+		}
+
+		/// Appends _record and returns once it is durable, with its sequence number in _lsn.
+		/// Safe to call from any number of threads, they share the syncs.
+		bool Append(std::string_view _record, std::uint64_t* _lsn = nullptr)
+		{
+			if (_record.size() > options.maxRecordSize)
+			{
+				return false;
+			}
+
+			// The payload part of the checksum needs no lock
+			const std::uint32_t payloadCrc = Utils::Checksum::Crc32c(_record);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!open || failed)
+			{
+				return false;
+			}
+
+			const std::uint64_t lsn = nextLsn++;
+			if (pending.empty())
+			{
+				pendingFirstLsn = lsn;
+			}
+			Encode(lsn, _record, payloadCrc);
+			if (_lsn != nullptr)
+			{
+				*_lsn = lsn;
+			}
+
+			while (durableLsn < lsn && !failed)
+			{
+				if (flushing)
+				{
+					committed.wait(lock);
+				}
+				else
+				{
+					CommitPending(lock);
+				}
+			}
+			return durableLsn >= lsn;
+		}
+
+		/// Hands every record from _fromLsn on to _onRecord in order. Meant for recovery
+		/// after Open, a tail still being written is skipped.
+		bool Replay(std::uint64_t _fromLsn, const ReplayCallback& _onRecord)
+		{
+			std::vector<Segment> snapshot;
+			{
+				std::lock_guard<std::mutex> lock(segmentsMutex);
+				snapshot = segments;
+			}
+
+			for (std::size_t i = 0; i < snapshot.size(); i++)
+			{
+				const bool isLast = i + 1 == snapshot.size();
+				if (!isLast && snapshot[i + 1].firstLsn <= _fromLsn)
+				{
+					continue;
+				}
+
+				const ScanEnd end = Scan(snapshot[i], _fromLsn, &_onRecord).end;
+				if (end == ScanEnd::Unreadable || (end == ScanEnd::Damaged && !isLast))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// Deletes the segments that hold only records before _lsn, as after a checkpoint.
+		/// The segment being written is kept. Returns how many were deleted, stops at the
+		/// first one that cannot be deleted so the remaining segments stay contiguous.
+		std::size_t RemoveBefore(std::uint64_t _lsn)
+		{
+			std::lock_guard<std::mutex> lock(segmentsMutex);
+
+			std::size_t removed = 0;
+			while (removed + 1 < segments.size() && segments[removed + 1].firstLsn <= _lsn)
+			{
+				if (!RemoveFile(segments[removed].path))
+				{
+					break;
+				}
+				removed++;
+			}
+			segments.erase(segments.begin(), segments.begin() + static_cast<std::ptrdiff_t>(removed));
+			return removed;
+		}
+
+		// Sequence number of the last durable record, 0 for an empty log
+		std::uint64_t LastLsn() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return durableLsn;
+		}
+
+		// Writes and syncs so far, appends per batch is the group commit ratio
+		std::uint64_t BatchCount() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return batches;
+		}
+
+		std::size_t SegmentCount() const
+		{
+			std::lock_guard<std::mutex> lock(segmentsMutex);
+			return segments.size();
+		}
+
+	private:
+		void Encode(std::uint64_t _lsn, std::string_view _record, std::uint32_t _payloadCrc)
+		{
+			const std::size_t at = pending.size();
+			pending.resize(at + kHeaderSize + _record.size());
+			char* record = pending.data() + at;
+
+			StoreLE(record + 4, static_cast<std::uint32_t>(_record.size()));
+			StoreLE(record + 8, _lsn);
+			std::memcpy(record + kHeaderSize, _record.data(), _record.size());
+			StoreLE(record, Utils::Checksum::Crc32c(record + 4, kHeaderSize - 4, _payloadCrc));
+		}
+
+		// Called with the lock held and flushing clear, returns with the lock held
+		void CommitPending(std::unique_lock<std::mutex>& _lock)
+		{
+			flushing = true;
+			if (options.commitDelay.count() > 0)
+			{
+				_lock.unlock();
+				std::this_thread::sleep_for(options.commitDelay);
+				_lock.lock();
+			}
+
+			writing.swap(pending);
+			pending.clear();
+			const std::uint64_t firstLsn = pendingFirstLsn;
+			const std::uint64_t lastLsn = nextLsn - 1;
+			_lock.unlock();
+
+			const bool written = WriteBatch(writing, firstLsn);
+			writing.clear();
+
+			_lock.lock();
+			flushing = false;
+			if (written)
+			{
+				durableLsn = lastLsn;
+				batches++;
+			}
+			else
+			{
+				failed = true;
+			}
+			committed.notify_all();
+		}
+
+		bool WriteBatch(const std::vector<char>& _batch, std::uint64_t _firstLsn)
+		{
+			if (!HasSegment() || (segmentBytes > 0 && segmentBytes + _batch.size() > options.segmentSize))
+			{
+				if (!RollSegment(_firstLsn))
+				{
+					return false;
+				}
+			}
+
+			if (!WriteAll(_batch.data(), _batch.size()))
+			{
+				return false;
+			}
+			segmentBytes += _batch.size();
+
+			return !options.sync || SyncSegment();
+		}
+
+		bool RollSegment(std::uint64_t _firstLsn)
+		{
+			CloseSegment();
+
+			Segment segment;
+			segment.firstLsn = _firstLsn;
+			segment.path = (PathStruct(directory) / SegmentName(_firstLsn)).GetPath();
+			if (!OpenSegment(segment.path))
+			{
+				return false;
+			}
+			segmentBytes = 0;
+
+			// The new directory entry has to be durable too
+			if (options.sync && !SyncDirectory())
+			{
+				return false;
+			}
+
+			std::lock_guard<std::mutex> lock(segmentsMutex);
+			segments.push_back(std::move(segment));
+			return true;
+		}
+
+		/// Walks _segment's records, handing the ones from _fromLsn on to _onRecord. Stops
+		/// at the first record that is cut off, fails its checksum or breaks the sequence.
+		/// maxRecordSize is not applied here, records written under a larger limit stay valid.
+		ScanResult Scan(const Segment& _segment, std::uint64_t _fromLsn, const ReplayCallback* _onRecord) const
+		{
+			ScanResult result;
+
+			FileIO file(PathStruct(_segment.path), std::ios::in | std::ios::binary);
+			const std::streamoff fileSize = file.IsOpen() ? static_cast<std::streamoff>(file.Size()) : -1;
+			if (fileSize < 0)
+			{
+				result.end = ScanEnd::Unreadable;
+				return result;
+			}
+
+			StreamBuffer buffer(file);
+			std::uint64_t expectedLsn = _segment.firstLsn;
+
+			// Bytes between the current record and the end of the file
+			auto remaining = [&]() { return static_cast<std::uint64_t>(fileSize) - result.validBytes; };
+
+			while (true)
+			{
+				if (!Require(buffer, kHeaderSize))
+				{
+					result.end = StopAt(buffer, remaining());
+					return result;
+				}
+
+				const char* header = buffer.Data();
+				const std::uint32_t crc = LoadLE<std::uint32_t>(header);
+				const std::uint32_t length = LoadLE<std::uint32_t>(header + 4);
+				const std::uint64_t lsn = LoadLE<std::uint64_t>(header + 8);
+				if (lsn != expectedLsn)
+				{
+					result.end = ScanEnd::Damaged;
+					return result;
+				}
+
+				// A torn length can be anything, the file size bounds what gets buffered
+				if (kHeaderSize + length > remaining())
+				{
+					result.end = ScanEnd::Damaged;
+					return result;
+				}
+				if (!Require(buffer, kHeaderSize + length))
+				{
+					result.end = StopAt(buffer, remaining());
+					return result;
+				}
+
+				const char* payload = buffer.Data() + kHeaderSize;
+				const std::uint32_t payloadCrc = Utils::Checksum::Crc32c(payload, static_cast<std::size_t>(length));
+				if (Utils::Checksum::Crc32c(buffer.Data() + 4, kHeaderSize - 4, payloadCrc) != crc)
+				{
+					result.end = ScanEnd::Damaged;
+					return result;
+				}
+
+				if (_onRecord != nullptr && lsn >= _fromLsn)
+				{
+					(*_onRecord)(lsn, std::string_view(payload, length));
+				}
+
+				buffer.Consume(kHeaderSize + length);
+				result.validBytes += kHeaderSize + length;
+				result.records++;
+				expectedLsn++;
+			}
+		}
+
+		// Why a read ended short: a tail shorter than a record, or a read error before the end
+		static ScanEnd StopAt(const StreamBuffer& _buffer, std::uint64_t _remaining)
+		{
+			if (_buffer.Available() < _remaining)
+			{
+				return ScanEnd::Unreadable;
+			}
+			return _buffer.Available() == 0 ? ScanEnd::Clean : ScanEnd::Damaged;
+		}
+
+		static bool Require(StreamBuffer& _buffer, std::size_t _bytes)
+		{
+			while (_buffer.Available() < _bytes)
+			{
+				if (!_buffer.Fill())
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		std::vector<Segment> ListSegments() const
+		{
+			std::vector<Segment> found;
+			std::mutex foundMutex;
+
+			WalkOptions walkOptions;
+			walkOptions.maxDepth = 0;
+			walkOptions.includeDirectories = false;
+
+			Pool::ThreadPool pool(1);
+			DirectoryWalker(pool, walkOptions).Walk(PathStruct(directory),
+				[&](const DirectoryEntry& _entry)
+				{
+					std::uint64_t firstLsn = 0;
+					if (_entry.type == EntryType::File && ParseSegmentName(_entry.name, firstLsn))
+					{
+						std::lock_guard<std::mutex> lock(foundMutex);
+						found.push_back(Segment{ firstLsn, std::string(_entry.path) });
+					}
+				}
+			);
+
+			std::sort(found.begin(), found.end(), [](const Segment& _a, const Segment& _b) { return _a.firstLsn < _b.firstLsn; });
+			return found;
+		}
+
+		// Zero padded so the names also sort by sequence number
+		static std::string SegmentName(std::uint64_t _firstLsn)
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), "%020llu.wal", static_cast<unsigned long long>(_firstLsn));
+			return name;
+		}
+
+		static bool ParseSegmentName(std::string_view _name, std::uint64_t& _firstLsn)
+		{
+			constexpr std::size_t kDigits = 20;
+			if (_name.size() != kDigits + 4 || _name.substr(kDigits) != ".wal")
+			{
+				return false;
+			}
+
+			_firstLsn = 0;
+			for (std::size_t i = 0; i < kDigits; i++)
+			{
+				if (_name[i] < '0' || _name[i] > '9')
+				{
+					return false;
+				}
+				_firstLsn = _firstLsn * 10 + static_cast<std::uint64_t>(_name[i] - '0');
+			}
+			return true;
+		}
+
+		template<typename Value>
+		static void StoreLE(char* _target, Value _value)
+		{
+			for (std::size_t i = 0; i < sizeof(Value); i++)
+			{
+				_target[i] = static_cast<char>((_value >> (8 * i)) & 0xFF);
+			}
+		}
+
+		template<typename Value>
+		static Value LoadLE(const char* _source)
+		{
+			Value value = 0;
+			for (std::size_t i = 0; i < sizeof(Value); i++)
+			{
+				value |= static_cast<Value>(static_cast<unsigned char>(_source[i])) << (8 * i);
+			}
+			return value;
+		}
+
+		/// Segment file
+		/// ------------------------------------------------------------
+#ifdef _WIN32
+		bool EnsureDirectory() const
+		{
+			return CreateDirectoryW(PathStruct(directory).GetPathW().c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+		}
+
+		bool HasSegment() const
+		{
+			return segmentHandle != INVALID_HANDLE_VALUE;
+		}
+
+		bool OpenSegment(const std::string& _path)
+		{
+			segmentHandle = CreateFileW(PathStruct(_path).GetPathW().c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+				OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (segmentHandle == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			LARGE_INTEGER zero{};
+			return SetFilePointerEx(segmentHandle, zero, nullptr, FILE_END);
+		}
+
+		void CloseSegment()
+		{
+			if (segmentHandle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(segmentHandle);
+				segmentHandle = INVALID_HANDLE_VALUE;
+			}
+		}
+
+		bool WriteAll(const char* _data, std::size_t _size)
+		{
+			while (_size > 0)
+			{
+				DWORD written = 0;
+				const DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(_size, 1u << 30));
+				if (!WriteFile(segmentHandle, _data, chunk, &written, nullptr))
+				{
+					return false;
+				}
+				_data += written;
+				_size -= written;
+			}
+			return true;
+		}
+
+		bool SyncSegment()
+		{
+			return FlushFileBuffers(segmentHandle);
+		}
+
+		// NTFS journals the directory entry with the file, nothing to do
+		bool SyncDirectory() const
+		{
+			return true;
+		}
+
+		static bool TruncateFile(const std::string& _path, std::uint64_t _size)
+		{
+			HANDLE file = CreateFileW(PathStruct(_path).GetPathW().c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			LARGE_INTEGER size;
+			size.QuadPart = static_cast<LONGLONG>(_size);
+			const bool truncated = SetFilePointerEx(file, size, nullptr, FILE_BEGIN) && SetEndOfFile(file) && FlushFileBuffers(file);
+			CloseHandle(file);
+			return truncated;
+		}
+
+		// A segment that is already gone counts as deleted
+		static bool RemoveFile(const std::string& _path)
+		{
+			return DeleteFileW(PathStruct(_path).GetPathW().c_str()) || GetLastError() == ERROR_FILE_NOT_FOUND;
+		}
+#else
+		bool EnsureDirectory() const
+		{
+			return mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST;
+		}
+
+		bool HasSegment() const
+		{
+			return segmentFd != -1;
+		}
+
+		bool OpenSegment(const std::string& _path)
+		{
+			segmentFd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+			return segmentFd != -1;
+		}
+
+		void CloseSegment()
+		{
+			if (segmentFd != -1)
+			{
+				close(segmentFd);
+				segmentFd = -1;
+			}
+		}
+
+		bool WriteAll(const char* _data, std::size_t _size)
+		{
+			while (_size > 0)
+			{
+				const ssize_t written = write(segmentFd, _data, _size);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					return false;
+				}
+				_data += written;
+				_size -= static_cast<std::size_t>(written);
+			}
+			return true;
+		}
+
+		bool SyncSegment()
+		{
+#ifdef __linux__
+			// The size is metadata fdatasync still writes, the timestamps it may skip
+			return fdatasync(segmentFd) == 0;
+#else
+			return fsync(segmentFd) == 0;
+#endif
+		}
+
+		bool SyncDirectory() const
+		{
+			const int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (directoryFd == -1)
+			{
+				return false;
+			}
+			const bool synced = fsync(directoryFd) == 0;
+			close(directoryFd);
+			return synced;
+		}
+
+		static bool TruncateFile(const std::string& _path, std::uint64_t _size)
+		{
+			return truncate(_path.c_str(), static_cast<off_t>(_size)) == 0;
+		}
+
+		static bool RemoveFile(const std::string& _path)
+		{
+			return unlink(_path.c_str()) == 0 || errno == ENOENT;
+		}
+#endif
+	};
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "network/MessageInterface.hpp"
+#include "filesystem/FileIO.hpp"
+
+namespace Net {
+
+	/// Receives a large message body chunk by chunk instead of buffering it whole.
+	/// Called on the connection's io thread.
+	struct IBodyConsumer {
+		// Returning false aborts the transfer and closes the connection
+		virtual bool OnChunk(const byte_type* _data, std::size_t _size) = 0;
+		virtual void OnComplete() = 0;
+		// Connection failed or the chunk was refused before the body ended
+		virtual void OnAbort() {}
+		virtual ~IBodyConsumer() = default;
+	};
+
+	/// Writes the body straight to a file
+	class FileBodyConsumer : public IBodyConsumer {
+	private:
+		FileS::FileIO file;
+
+	public:
+		explicit FileBodyConsumer(const FileS::PathStruct& _path)
+			: file(_path, std::ios::out | std::ios::binary | std::ios::trunc) {}
+
+		bool IsOpen() const { return file.IsOpen(); }
+
+		bool OnChunk(const byte_type* _data, std::size_t _size) override {
+			return static_cast<bool>(file.Write(reinterpret_cast<const char*>(_data), static_cast<std::streamsize>(_size)));
+		}
+
+		void OnComplete() override { file.Close(); }
+
+		void OnAbort() override { file.Close(); }
+	};
+
+}
\ No newline at end of file
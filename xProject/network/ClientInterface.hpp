@@ -1,75 +1,562 @@
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
 #include "Connection.hpp"
+#include "utils/Coroutine.hpp"
 
 namespace Net {
 
+	struct ConnectOptions {
+		// 0 waits for the operating system to give up
+		std::chrono::milliseconds connectTimeout{ 5000 };
+
+		// Retries failed attempts and lost connections, messages sent meanwhile go out once reconnected
+		bool reconnect = false;
+		std::chrono::milliseconds initialBackoff{ 100 };
+		std::chrono::milliseconds maxBackoff{ 10000 };
+		// Failed attempts in a row before giving up, 0 retries forever
+		std::size_t maxAttempts = 0;
+		// Messages kept while disconnected, newer ones are dropped
+		std::size_t maxBuffered = 1024;
+	};
+
 	template<typename MessageIMPL>
 	class ClientInterface {
+	public:
+		using CallResult = std::optional<MessageIMPL>;
+		using CallCallback = std::function<void(CallResult _reply)>;
+		// Completion of Connect(): success or the error of the last attempt
+		using ConnectCallback = std::function<void(ERROR_CODE _error_code)>;
+
 	protected:
-		std::unique_ptr<Net::Connection<MessageIMPL>> connection;
-		asio::io_service connectContext;
+		// Empty when the client runs on a shared io_service
+		std::unique_ptr<asio::io_service> ownContext;
+		asio::io_service& connectContext;
 
 		std::thread threadContext;
 	private:
-		Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>> msgQueueIn;
+		Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>> ownQueueIn;
+		Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>>& msgQueueIn;
+		ConnectionOptions connectionOptions;
+		ConnectOptions connectOptions;
+		typename Connection<MessageIMPL>::BodyConsumerFactory bodyConsumerFactory;
+
+		struct PendingCall {
+			CallCallback complete;
+			std::unique_ptr<Utils::TimerNode> timer;
+		};
+
+		/// Calls in flight. Shared with the io handlers, which may still run after
+		/// the client is gone when the io_service is not its own.
+		struct CallState {
+			TimerService& timers;
+			std::mutex mutex;
+			std::unordered_map<std::uint32_t, PendingCall> pending;
+
+			explicit CallState(TimerService& _timers) : timers(_timers) {}
+
+			// Runs on the io thread for every received message
+			bool Complete(MessageIMPL& _msg) {
+				const std::uint32_t requestId = _msg.Header().RequestId();
+				if (requestId == 0) {
+					return false;
+				}
+
+				PendingCall call;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+
+					auto it = pending.find(requestId);
+					if (it == pending.end()) {
+						return false;
+					}
+					call = std::move(it->second);
+					pending.erase(it);
+				}
+
+				if (call.timer) {
+					timers.Cancel(*call.timer);
+				}
+				call.complete(std::move(_msg));
+				return true;
+			}
+
+			void Fail(std::uint32_t _requestId) {
+				PendingCall call;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+
+					auto it = pending.find(_requestId);
+					if (it == pending.end()) {
+						return;
+					}
+					call = std::move(it->second);
+					pending.erase(it);
+				}
+
+				// A no-op when called from the timer itself
+				if (call.timer) {
+					timers.Cancel(*call.timer);
+				}
+				call.complete(std::nullopt);
+			}
+
+			void FailAll() {
+				std::unordered_map<std::uint32_t, PendingCall> calls;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					calls.swap(pending);
+				}
+
+				for (auto& [requestId, call] : calls) {
+					if (call.timer) {
+						timers.Cancel(*call.timer);
+					}
+					call.complete(std::nullopt);
+				}
+			}
+		};
+
+		/// Session
+		/// ------------------------------------------------------------
+		/// Resolves, connects and reconnects without blocking the caller. Resolver and timers
+		/// are driven through the strand, the connection and the outgoing buffer under the mutex.
+		struct Session : std::enable_shared_from_this<Session> {
+			asio::io_service& context;
+			Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>>& incoming;
+			asio::strand<asio::io_service::executor_type> strand;
+
+			asio::ip::tcp::resolver resolver;
+			asio::steady_timer connectTimer;
+			asio::steady_timer backoffTimer;
+
+			std::string host;
+			std::string port;
+			ConnectionOptions connectionOptions;
+			ConnectOptions connectOptions;
+			typename Connection<MessageIMPL>::BodyConsumerFactory bodyConsumerFactory;
+			std::shared_ptr<CallState> callState;
+
+			ConnectCallback onConnect;
+			std::size_t attempts = 0;
+			std::chrono::milliseconds backoff{ 0 };
+
+			std::mutex mutex;
+			std::shared_ptr<Connection<MessageIMPL>> connection;
+			std::deque<MessageIMPL> unsent;
+			bool establishedOnce = false;
+			bool gaveUp = false;
+			std::atomic<bool> connected = false;
+			std::atomic<bool> stopped = false;
+
+			Session(asio::io_service& _context, Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>>& _incoming)
+				: context(_context), incoming(_incoming), strand(asio::make_strand(_context)),
+				  resolver(strand), connectTimer(strand), backoffTimer(strand) {}
+
+			void Start() {
+				backoff = connectOptions.initialBackoff;
+				asio::post(strand, [self = this->shared_from_this()]() { self->Resolve(); });
+			}
+
+			// Any thread; the cleanup runs on the strand, _onStopped once the connection is closed
+			void Stop(std::function<void()> _onStopped = nullptr) {
+				stopped = true;
+				asio::post(strand, [self = this->shared_from_this(), onStopped = std::move(_onStopped)]() mutable { self->Shutdown(std::move(onStopped)); });
+			}
+
+			// False when the message was dropped
+			bool Send(const MessageIMPL& _msg) {
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (connected) {
+					connection->Send(_msg);
+					return true;
+				}
+				// Held until the first connect, after that only while reconnecting
+				if (stopped || gaveUp || (establishedOnce && !connectOptions.reconnect)) {
+					return false;
+				}
+				if (unsent.size() >= connectOptions.maxBuffered) {
+					XLOG_WARN("Client send buffer is full, message dropped");
+					return false;
+				}
+
+				unsent.push_back(_msg);
+				return true;
+			}
+
+			template<typename Func>
+			auto WithConnection(Func&& _func) -> decltype(_func(*connection)) {
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!connection) {
+					return {};
+				}
+				return _func(*connection);
+			}
+
+		private:
+			void Resolve() {
+				if (stopped) {
+					return;
+				}
+
+				resolver.async_resolve(host, port,
+					[self = this->shared_from_this()](ERROR_CODE _error_code, asio::ip::tcp::resolver::results_type _endpoints) {
+						if (_error_code) {
+							self->Failed(_error_code);
+						}
+						else {
+							self->Attempt(_endpoints);
+						}
+					}
+				);
+			}
+
+			void Attempt(const asio::ip::tcp::resolver::results_type& _endpoints) {
+				if (stopped) {
+					return;
+				}
+
+				std::shared_ptr<Connection<MessageIMPL>> attempt = std::make_shared<Connection<MessageIMPL>>(Connection<MessageIMPL>::OwnerConnection::Client, context, SOCKET(context), incoming, connectionOptions);
+				attempt->SetBodyConsumerFactory(bodyConsumerFactory);
+				attempt->SetIncomingFilter([callState = callState](MessageIMPL& _msg) { return callState->Complete(_msg); });
+
+				std::weak_ptr<Session> weakSelf = this->shared_from_this();
+				std::weak_ptr<Connection<MessageIMPL>> weakAttempt = attempt;
+				attempt->SetCloseHandler(
+					[weakSelf, weakAttempt](std::vector<MessageIMPL> _unsent) {
+						if (std::shared_ptr<Session> self = weakSelf.lock()) {
+							self->Lost(weakAttempt.lock(), std::move(_unsent));
+						}
+					}
+				);
+
+				// Whichever of the connect completion and the timeout comes first decides the attempt,
+				// a timeout queued behind a completed connect must not tear the connection down
+				std::shared_ptr<std::atomic<bool>> settled = std::make_shared<std::atomic<bool>>(false);
+
+				if (connectOptions.connectTimeout.count() > 0) {
+					connectTimer.expires_after(connectOptions.connectTimeout);
+					connectTimer.async_wait(
+						[attempt, settled](ERROR_CODE _error_code) {
+							if (!_error_code && !settled->exchange(true)) {
+								attempt->Disconnect();
+							}
+						}
+					);
+				}
+
+				attempt->ConnectToServer(_endpoints,
+					[self = this->shared_from_this(), attempt, settled](ERROR_CODE _error_code) {
+						if (settled->exchange(true)) {
+							_error_code = asio::error::timed_out;
+						}
+
+						asio::post(self->strand, [self, attempt, _error_code]() {
+							self->connectTimer.cancel();
+
+							if (_error_code) {
+								self->Failed(_error_code == asio::error::operation_aborted && !self->stopped ? asio::error::timed_out : _error_code);
+							}
+							else {
+								self->Connected(attempt);
+							}
+						});
+					}
+				);
+			}
+
+			void Connected(const std::shared_ptr<Connection<MessageIMPL>>& _connection) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (stopped) {
+						_connection->Disconnect();
+						return;
+					}
+
+					connection = _connection;
+					connected = true;
+					establishedOnce = true;
+
+					// Still under the lock, so nothing sent later overtakes them
+					if (!unsent.empty()) {
+						connection->Send(std::vector<MessageIMPL>(std::make_move_iterator(unsent.begin()), std::make_move_iterator(unsent.end())));
+						unsent.clear();
+					}
+				}
+
+				attempts = 0;
+				backoff = connectOptions.initialBackoff;
+				XLOG_DEBUG("Connected to {}:{}", host, port);
+
+				Notify(ERROR_CODE());
+			}
+
+			void Failed(ERROR_CODE _error_code) {
+				if (stopped) {
+					return;
+				}
+
+				attempts++;
+				XLOG_DEBUG("Connecting to {}:{} failed: {}", host, port, _error_code.message());
+
+				if (!connectOptions.reconnect || (connectOptions.maxAttempts != 0 && attempts >= connectOptions.maxAttempts)) {
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						unsent.clear();
+						gaveUp = true;
+					}
+					Notify(_error_code);
+					return;
+				}
+
+				backoffTimer.expires_after(backoff);
+				backoffTimer.async_wait(
+					[self = this->shared_from_this()](ERROR_CODE _error_code) {
+						if (!_error_code) {
+							// Resolved again, the address may have moved
+							self->Resolve();
+						}
+					}
+				);
+				backoff = std::min(backoff * 2, connectOptions.maxBackoff);
+			}
+
+			// Runs on the strand of the lost connection
+			void Lost(const std::shared_ptr<Connection<MessageIMPL>>& _connection, std::vector<MessageIMPL> _unsent) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!_connection || connection != _connection) {
+						return;
+					}
+
+					connection.reset();
+					connected = false;
+
+					// A message cut off mid-write is sent again in full
+					if (connectOptions.reconnect && !stopped) {
+						unsent.insert(unsent.begin(), std::make_move_iterator(_unsent.begin()), std::make_move_iterator(_unsent.end()));
+					}
+				}
+
+				if (connectOptions.reconnect && !stopped) {
+					XLOG_DEBUG("Connection to {}:{} lost, reconnecting", host, port);
+					asio::post(strand, [self = this->shared_from_this()]() { self->Failed(asio::error::connection_reset); });
+				}
+			}
+
+			void Shutdown(std::function<void()> _onStopped) {
+				resolver.cancel();
+				connectTimer.cancel();
+				backoffTimer.cancel();
+
+				std::shared_ptr<Connection<MessageIMPL>> lastConnection;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					lastConnection = std::move(connection);
+					connected = false;
+					unsent.clear();
+				}
+
+				Notify(asio::error::operation_aborted);
+
+				if (lastConnection) {
+					lastConnection->Disconnect(std::move(_onStopped));
+				}
+				else if (_onStopped) {
+					_onStopped();
+				}
+			}
+
+			// Completes Connect() once
+			void Notify(ERROR_CODE _error_code) {
+				if (onConnect) {
+					ConnectCallback callback = std::move(onConnect);
+					onConnect = nullptr;
+					callback(_error_code);
+				}
+			}
+		};
+
+		std::shared_ptr<CallState> callState = std::make_shared<CallState>(TimerService::For(connectContext));
+		std::shared_ptr<Session> session;
+		std::atomic<std::uint32_t> nextRequestId = 1;
 
 	public:
-		ClientInterface() = default;
+		ClientInterface() : ownContext(std::make_unique<asio::io_service>()), connectContext(*ownContext), msgQueueIn(ownQueueIn) {}
+
+		// Runs on _context, kept running by the caller; messages that are not call replies go to _incoming
+		ClientInterface(asio::io_service& _context, Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>>& _incoming)
+			: connectContext(_context), msgQueueIn(_incoming) {}
+
 		~ClientInterface() { Disconnect(); }
 
-		void Connect(const std::string& _host, const uint16_t& _port) {
-			asio::ip::tcp::resolver resolver(connectContext);
-			asio::ip::tcp::resolver::results_type endpoint = resolver.resolve(_host, std::to_string(_port));
+		/// Returns at once, resolving and connecting run on the io thread. _onConnect runs there
+		/// with the outcome of the first successful or the last failed attempt.
+		void Connect(const std::string& _host, const uint16_t& _port, ConnectCallback _onConnect) {
+			Disconnect();
+
+			session = std::make_shared<Session>(connectContext, msgQueueIn);
+			session->host = _host;
+			session->port = std::to_string(_port);
+			session->connectionOptions = connectionOptions;
+			session->connectOptions = connectOptions;
+			session->bodyConsumerFactory = bodyConsumerFactory;
+			session->callState = callState;
+			session->onConnect = std::move(_onConnect);
+			session->Start();
+
+			if (ownContext) {
+				connectContext.restart();
+				threadContext = std::thread([this]() {
+					asio::executor_work_guard<asio::io_service::executor_type> workGuard(connectContext.get_executor());
+					connectContext.run();
+				});
+			}
+		}
 
-			connection = std::make_unique<Net::Connection<MessageIMPL>>(Net::Connection<MessageIMPL>::OwnerConnection::Client, connectContext, SOCKET(connectContext), msgQueueIn);
+		std::future<ERROR_CODE> Connect(const std::string& _host, const uint16_t& _port) {
+			auto promise = std::make_shared<std::promise<ERROR_CODE>>();
+			std::future<ERROR_CODE> future = promise->get_future();
+
+			Connect(_host, _port, [promise](ERROR_CODE _error_code) { promise->set_value(_error_code); });
+			return future;
+		}
 
-			connection->ConnectToServer(endpoint);
+		// Applies to the next Connect()
+		void SetConnectionOptions(const ConnectionOptions& _options) {
+			connectionOptions = _options;
+		}
+
+		// Applies to the next Connect()
+		void SetConnectOptions(const ConnectOptions& _options) {
+			connectOptions = _options;
+		}
 
-			threadContext = std::thread([this]() { connectContext.run(); });
+		// Applies to the next Connect()
+		void SetBodyConsumerFactory(typename Connection<MessageIMPL>::BodyConsumerFactory _factory) {
+			bodyConsumerFactory = std::move(_factory);
 		}
 
 		void Disconnect() {
-			if (IsConnected()) {
-				connection->Disconnect();
+			if (!session) {
+				return;
 			}
 
-			connectContext.stop();
-			if (threadContext.joinable()) {
-				threadContext.join();
+			if (ownContext) {
+				// The io thread has to close the socket and run the close handler before it is stopped
+				std::promise<void> stopped;
+				session->Stop([&stopped]() { stopped.set_value(); });
+				stopped.get_future().wait();
+
+				connectContext.stop();
+				if (threadContext.joinable()) {
+					threadContext.join();
+				}
+			}
+			else {
+				session->Stop();
 			}
+			session.reset();
 
-			connection.release();
+			callState->FailAll();
 		}
 
 		bool IsConnected() {
-			if (connection) {
-				return connection->IsConnected();
-			}
-			else {
-				return false;
-			}
+			return session && session->connected;
 		}
 
+		/// Messages sent before the first connect or while reconnecting wait in the
+		/// session buffer, otherwise they are dropped when not connected
 		void Send(const MessageIMPL& _msg) {
-			if (IsConnected()) {
-				connection->Send(_msg);
+			if (session) {
+				session->Send(_msg);
 			}
 		}
 
+		/// Sends _msg as a request and hands the first message carrying its request id to _onReply,
+		/// or std::nullopt on timeout or Disconnect(). Any number of calls may be outstanding on
+		/// the connection. _onReply runs on the io thread, a zero _timeout waits indefinitely.
+		/// Replies that arrive after their call finished go to Incoming().
+		void Call(MessageIMPL _msg, std::chrono::milliseconds _timeout, CallCallback _onReply) {
+			if (!session) {
+				_onReply(std::nullopt);
+				return;
+			}
+
+			const std::uint32_t requestId = NextRequestId();
+			_msg.Header().SetRequestId(requestId);
+
+			{
+				std::lock_guard<std::mutex> lock(callState->mutex);
+
+				PendingCall& call = callState->pending[requestId];
+				call.complete = std::move(_onReply);
+				if (_timeout.count() > 0) {
+					call.timer = std::make_unique<Utils::TimerNode>();
+					callState->timers.Schedule(*call.timer, _timeout,
+						[callState = callState, requestId]() {
+							callState->Fail(requestId);
+						}
+					);
+				}
+			}
+
+			if (!session->Send(_msg)) {
+				callState->Fail(requestId);
+			}
+		}
+
+		std::future<CallResult> Call(const MessageIMPL& _msg, std::chrono::milliseconds _timeout) {
+			auto promise = std::make_shared<std::promise<CallResult>>();
+			std::future<CallResult> future = promise->get_future();
+
+			Call(_msg, _timeout, [promise](CallResult _reply) { promise->set_value(std::move(_reply)); });
+			return future;
+		}
+
+		// co_await inside a Pool::Task, the coroutine resumes on its own pool
+		Pool::AsyncResult<CallResult> CallAsync(const MessageIMPL& _msg, std::chrono::milliseconds _timeout) {
+			Pool::AsyncResult<CallResult> result;
+
+			Call(_msg, _timeout, [result](CallResult _reply) { result.Complete(std::move(_reply)); });
+			return result;
+		}
+
+		std::size_t PendingCalls() {
+			std::lock_guard<std::mutex> lock(callState->mutex);
+			return callState->pending.size();
+		}
+
 		std::string GetAddress() const
 		{
-			return connection->GetAddressLocal();
+			return session ? session->WithConnection([](Connection<MessageIMPL>& _connection) { return _connection.GetAddressLocal(); }) : std::string();
 		}
 
 		std::uint16_t GetPort() const
 		{
-			return connection->GetPortLocal();
+			return session ? session->WithConnection([](Connection<MessageIMPL>& _connection) { return _connection.GetPortLocal(); }) : 0;
 		}
 
 		Utils::QueueLF<std::shared_ptr<OwnerMessage<MessageIMPL>>>& Incoming() {
 			return msgQueueIn;
 		}
+
+	private:
+		std::uint32_t NextRequestId() {
+			// 0 marks messages outside of a call
+			std::uint32_t requestId = nextRequestId.fetch_add(1, std::memory_order_relaxed);
+			while (requestId == 0) {
+				requestId = nextRequestId.fetch_add(1, std::memory_order_relaxed);
+			}
+			return requestId;
+		}
 	};
 
 }
\ No newline at end of file
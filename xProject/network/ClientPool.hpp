@@ -0,0 +1,205 @@
+#pragma once
+
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "network/ClientInterface.hpp"
+
+namespace Net {
+
+	enum class BalancePolicy {
+		// Next connected member in turn
+		RoundRobin,
+		// Member with the fewest calls awaiting a reply
+		LeastOutstanding
+	};
+
+	/// ClientPool
+	/// ------------------------------------------------------------
+	/// Several connections to each of several servers, all driven by one set of io threads.
+	/// Send and Call pick a connected member by the balance policy. Messages that are not
+	/// call replies arrive from every member in one Incoming() queue.
+	template<typename MessageIMPL>
+	class ClientPool {
+	public:
+		using CallResult = typename ClientInterface<MessageIMPL>::CallResult;
+		using CallCallback = typename ClientInterface<MessageIMPL>::CallCallback;
+
+	private:
+		struct Member {
+			std::unique_ptr<ClientInterface<MessageIMPL>> client;
+			// Shared with reply callbacks, which may finish while the pool stops
+			std::shared_ptr<std::atomic<std::size_t>> outstanding = std::make_shared<std::atomic<std::size_t>>(0);
+		};
+
+		asio::io_service connectContext;
+		asio::executor_work_guard<asio::io_service::executor_type> workGuard;
+		std::vector<std::thread> threadsContext;
+
+		Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>> msgQueueIn;
+		ConnectionOptions connectionOptions;
+		ConnectOptions connectOptions;
+		BalancePolicy policy;
+
+		std::shared_mutex membersMutex;
+		std::vector<std::unique_ptr<Member>> members;
+		std::atomic<std::size_t> cursor = 0;
+
+	public:
+		explicit ClientPool(std::size_t _ioThreads = 1, BalancePolicy _policy = BalancePolicy::RoundRobin)
+			: workGuard(asio::make_work_guard(connectContext)), policy(_policy)
+		{
+			for (std::size_t i = 0; i < std::max<std::size_t>(_ioThreads, 1); i++) {
+				threadsContext.emplace_back([this]() { connectContext.run(); });
+			}
+		}
+		~ClientPool() { Stop(); }
+
+		// Applies to endpoints added afterwards
+		void SetConnectionOptions(const ConnectionOptions& _options) {
+			connectionOptions = _options;
+		}
+
+		// Applies to endpoints added afterwards
+		void SetConnectOptions(const ConnectOptions& _options) {
+			connectOptions = _options;
+		}
+
+		// Connects in the background, members take traffic once connected
+		void AddEndpoint(const std::string& _host, std::uint16_t _port, std::size_t _connections = 1) {
+			std::vector<std::unique_ptr<Member>> added;
+			for (std::size_t i = 0; i < _connections; i++) {
+				std::unique_ptr<Member> member = std::make_unique<Member>();
+				member->client = std::make_unique<ClientInterface<MessageIMPL>>(connectContext, msgQueueIn);
+				member->client->SetConnectionOptions(connectionOptions);
+				member->client->SetConnectOptions(connectOptions);
+				member->client->Connect(_host, _port);
+
+				added.push_back(std::move(member));
+			}
+
+			std::unique_lock<std::shared_mutex> lock(membersMutex);
+			for (std::unique_ptr<Member>& member : added) {
+				members.push_back(std::move(member));
+			}
+		}
+
+		void Stop() {
+			std::vector<std::unique_ptr<Member>> stopping;
+			{
+				std::unique_lock<std::shared_mutex> lock(membersMutex);
+				stopping.swap(members);
+			}
+
+			// Outside the lock, failed calls run their callbacks and those may call back into the pool
+			for (std::unique_ptr<Member>& member : stopping) {
+				member->client->Disconnect();
+			}
+			stopping.clear();
+
+			workGuard.reset();
+			connectContext.stop();
+			for (std::thread& thread : threadsContext) {
+				if (thread.joinable()) {
+					thread.join();
+				}
+			}
+		}
+
+		std::size_t Size() {
+			std::shared_lock<std::shared_mutex> lock(membersMutex);
+			return members.size();
+		}
+
+		std::size_t ConnectedCount() {
+			std::shared_lock<std::shared_mutex> lock(membersMutex);
+			return std::count_if(members.begin(), members.end(),
+				[](const std::unique_ptr<Member>& _member) { return _member->client->IsConnected(); });
+		}
+
+		// False when no member is connected
+		bool Send(const MessageIMPL& _msg) {
+			std::shared_lock<std::shared_mutex> lock(membersMutex);
+
+			Member* member = Pick();
+			if (member == nullptr) {
+				return false;
+			}
+
+			member->client->Send(_msg);
+			return true;
+		}
+
+		/// Same contract as ClientInterface::Call, completes with std::nullopt at once
+		/// when no member is connected
+		void Call(const MessageIMPL& _msg, std::chrono::milliseconds _timeout, CallCallback _onReply) {
+			std::shared_lock<std::shared_mutex> lock(membersMutex);
+
+			Member* member = Pick();
+			if (member == nullptr) {
+				lock.unlock();
+				_onReply(std::nullopt);
+				return;
+			}
+
+			member->outstanding->fetch_add(1, std::memory_order_relaxed);
+			member->client->Call(_msg, _timeout,
+				[outstanding = member->outstanding, onReply = std::move(_onReply)](CallResult _reply)
+				{
+					outstanding->fetch_sub(1, std::memory_order_relaxed);
+					onReply(std::move(_reply));
+				}
+			);
+		}
+
+		std::future<CallResult> Call(const MessageIMPL& _msg, std::chrono::milliseconds _timeout) {
+			auto promise = std::make_shared<std::promise<CallResult>>();
+			std::future<CallResult> future = promise->get_future();
+
+			Call(_msg, _timeout, [promise](CallResult _reply) { promise->set_value(std::move(_reply)); });
+			return future;
+		}
+
+		Pool::AsyncResult<CallResult> CallAsync(const MessageIMPL& _msg, std::chrono::milliseconds _timeout) {
+			Pool::AsyncResult<CallResult> result;
+
+			Call(_msg, _timeout, [result](CallResult _reply) { result.Complete(std::move(_reply)); });
+			return result;
+		}
+
+		Utils::QueueLF<std::shared_ptr<OwnerMessage<MessageIMPL>>>& Incoming() {
+			return msgQueueIn;
+		}
+
+	private:
+		// Caller holds membersMutex
+		Member* Pick() {
+			const std::size_t count = members.size();
+			if (count == 0) {
+				return nullptr;
+			}
+
+			// The rotating start also spreads ties of LeastOutstanding
+			const std::size_t start = cursor.fetch_add(1, std::memory_order_relaxed);
+
+			Member* best = nullptr;
+			for (std::size_t i = 0; i < count; i++) {
+				Member* member = members[(start + i) % count].get();
+				if (!member->client->IsConnected()) {
+					continue;
+				}
+
+				if (policy == BalancePolicy::RoundRobin) {
+					return member;
+				}
+
+				if (best == nullptr || member->outstanding->load(std::memory_order_relaxed) < best->outstanding->load(std::memory_order_relaxed)) {
+					best = member;
+				}
+			}
+			return best;
+		}
+	};
+
+}
\ No newline at end of file
@@ -1,14 +1,43 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 
 #include <boost/asio.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/system/error_code.hpp>
 
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define XPROJECT_HAS_SENDFILE 1
+#elif defined(_WIN32) && defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
+#include <mswsock.h>
+#pragma comment(lib, "mswsock.lib")
+#define XPROJECT_HAS_TRANSMITFILE 1
+#endif
+
 #include "collections/QeueuLockfree.hpp"
 
+#include "filesystem/FileIO.hpp"
+#include "filesystem/MappedFile.hpp"
+#include "filesystem/PathStruct.hpp"
+
 #include "network/MessageInterface.hpp"
+#include "network/BodyConsumer.hpp"
+#include "network/TimerService.hpp"
+#include "utils/Compression.hpp"
+#include "utils/Log.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/SerialExecutor.hpp"
 
 namespace Net {
 
@@ -18,6 +47,55 @@ namespace Net {
 	using ENDPOINT = asio::ip::tcp::endpoint;
 	using ERROR_CODE = boost::system::error_code;
 
+	struct ConnectionOptions {
+		// Bodies of at least this many bytes are compressed when it makes them smaller, 0 disables compression
+		std::size_t compressionThreshold = 0;
+
+		// Largest body buffered in memory, bigger frames close the connection unless streamed
+		std::size_t maxFrameSize = 16 * 1024 * 1024;
+
+		// Uncompressed bodies above this size go to the body consumer in streamChunkSize pieces, 0 disables streaming
+		std::size_t streamThreshold = 0;
+		std::size_t streamChunkSize = 64 * 1024;
+
+		// Closes the connection after this long without receiving anything, 0 disables
+		std::chrono::milliseconds idleTimeout{ 0 };
+		// Sends a heartbeat frame after this long without sending anything, 0 disables.
+		// Should be well below the peer's idleTimeout.
+		std::chrono::milliseconds heartbeatInterval{ 0 };
+	};
+
+	/// Traffic of one connection, readable from any thread
+	struct ConnectionStats {
+		std::atomic<std::uint64_t> bytesReceived = 0;
+		std::atomic<std::uint64_t> bytesSent = 0;
+		std::atomic<std::uint64_t> messagesReceived = 0;
+		std::atomic<std::uint64_t> messagesSent = 0;
+	};
+
+	/// Totals of all connections in Utils::MetricsRegistry::Global()
+	struct NetMetrics {
+		Utils::Counter& bytesReceived;
+		Utils::Counter& bytesSent;
+		Utils::Counter& messagesReceived;
+		Utils::Counter& messagesSent;
+		Utils::Gauge& activeConnections;
+
+		static NetMetrics& Get() {
+			static NetMetrics metrics = []() {
+				Utils::MetricsRegistry& registry = Utils::MetricsRegistry::Global();
+				return NetMetrics{
+					registry.GetCounter("net_bytes_received_total", "Bytes read from all connections"),
+					registry.GetCounter("net_bytes_sent_total", "Bytes written to all connections"),
+					registry.GetCounter("net_messages_received_total", "Messages received, heartbeats included"),
+					registry.GetCounter("net_messages_sent_total", "Messages written, heartbeats included"),
+					registry.GetGauge("net_active_connections", "Established connections not closed yet")
+				};
+			}();
+			return metrics;
+		}
+	};
+
 	template<typename MessageIMPL>
 	class Connection : public std::enable_shared_from_this<Connection<MessageIMPL>> {
 	public:
@@ -25,23 +103,150 @@ namespace Net {
 			Server, Client
 		};
 
+		// Called with the decoded header of a large message, nullptr falls back to buffering
+		using BodyConsumerFactory = std::function<std::unique_ptr<IBodyConsumer>(const MessageIMPL& _msg)>;
+
+		// Sees every received message on the io thread first, returns true when it took the message
+		using IncomingFilter = std::function<bool(MessageIMPL& _msg)>;
+
+		// Runs once on the io thread when an established connection closes, with the messages never fully written
+		using CloseHandler = std::function<void(std::vector<MessageIMPL> _unsent)>;
+
+		// Runs on the io thread once the body of a SendFile is written or has failed
+		using FileSentHandler = std::function<void(ERROR_CODE)>;
+
 	private:
+		/// FileTransfer
+		/// ------------------------------------------------------------
+		/// A file range queued by SendFile, it belongs to the first message in msgQueueOut
+		/// flagged kFlagFileBody
+		struct FileTransfer {
+			FileS::PathStruct path;
+			std::uint64_t offset = 0;
+			std::uint64_t remaining = 0;
+			FileSentHandler onSent;
+			// Some of the range went out, a failure can no longer switch to the mapping
+			bool started = false;
+
+			// Written from a read-only mapping where the kernel cannot send the file itself
+			bool useMapping = false;
+			FileS::MappedFile mapped;
+#if defined(XPROJECT_HAS_SENDFILE)
+			int fileDescriptor = -1;
+#elif defined(XPROJECT_HAS_TRANSMITFILE)
+			HANDLE fileHandle = INVALID_HANDLE_VALUE;
+#endif
+
+			~FileTransfer() {
+#if defined(XPROJECT_HAS_SENDFILE)
+				if (fileDescriptor != -1) {
+					::close(fileDescriptor);
+				}
+#elif defined(XPROJECT_HAS_TRANSMITFILE)
+				if (fileHandle != INVALID_HANDLE_VALUE) {
+					CloseHandle(fileHandle);
+				}
+#endif
+			}
+
+			bool Open(std::uint64_t& _fileSize) {
+#if defined(XPROJECT_HAS_SENDFILE)
+				fileDescriptor = ::open(path.GetPath().c_str(), O_RDONLY | O_CLOEXEC);
+				struct stat fileStat;
+				if (fileDescriptor == -1 || fstat(fileDescriptor, &fileStat) != 0) {
+					return false;
+				}
+				_fileSize = static_cast<std::uint64_t>(fileStat.st_size);
+				return true;
+#elif defined(XPROJECT_HAS_TRANSMITFILE)
+				fileHandle = CreateFileW(path.GetPathW().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+				LARGE_INTEGER fileSize;
+				if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize)) {
+					return false;
+				}
+				_fileSize = static_cast<std::uint64_t>(fileSize.QuadPart);
+				return true;
+#else
+				useMapping = true;
+				if (!mapped.Open(path, FileS::MapMode::ReadOnly, FileS::AccessHint::Sequential)) {
+					return false;
+				}
+				_fileSize = mapped.Size();
+				return true;
+#endif
+			}
+		};
+
+		// Largest range one sendfile or TransmitFile call takes
+		static constexpr std::uint64_t kMaxFileChunk = 0x7FFFF000;
+		// Bytes a whole-body read asks for at a time, each piece counts as activity for idleTimeout
+		static constexpr std::size_t kBodyReadPiece = 64 * 1024;
+
 		SOCKET connectSocket;
 		asio::io_service& connectContext;
+		// Serializes the handlers of this connection when several threads run the context
+		asio::strand<asio::io_service::executor_type> strand;
 	
 		Utils::QueueLF<MessageIMPL> msgQueueOut;
+		// Touched on the strand only
+		std::deque<std::unique_ptr<FileTransfer>> fileQueueOut;
 		Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>>& msgQueueIn;
 
 		MessageIMPL temporaryMessage;
 
+		// Encoded headers, one read and one write are in flight at a time
+		std::array<byte_type, MessageIMPL::headerSize> readHeaderBuffer{};
+		std::array<byte_type, MessageIMPL::headerSize> writeHeaderBuffer{};
+
 		OwnerConnection owner;
+		ConnectionOptions options;
+
+		BodyConsumerFactory bodyConsumerFactory;
+		IncomingFilter incomingFilter;
+		CloseHandler closeHandler;
+		bool established = false;
+		bool closed = false;
+
+		TimerService& timers;
+		Utils::TimerNode idleTimer;
+		Utils::TimerNode heartbeatTimer;
+		TimerService::Clock::time_point lastReceive;
+		TimerService::Clock::time_point lastSend;
+		std::unique_ptr<IBodyConsumer> bodyConsumer;
+		std::vector<byte_type> streamBuffer;
+		std::size_t streamRemaining = 0;
+
+		ConnectionStats stats;
+		NetMetrics& metrics = NetMetrics::Get();
+
+		// Runs the handlers of this connection's messages, one at a time in arrival order
+		std::once_flag handlerExecutorOnce;
+		std::shared_ptr<Pool::SerialExecutor> handlerExecutor;
 	public:
-		Connection(OwnerConnection _owner, asio::io_service& _context, SOCKET _socket, Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>>& _msgIn)
-			: connectContext(_context), connectSocket(std::move(_socket)), msgQueueIn(_msgIn)
+		Connection(OwnerConnection _owner, asio::io_service& _context, SOCKET _socket, Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>>& _msgIn,
+				   const ConnectionOptions& _options = ConnectionOptions())
+			: connectContext(_context), connectSocket(std::move(_socket)), strand(asio::make_strand(_context)), msgQueueIn(_msgIn), options(_options),
+			  timers(TimerService::For(_context))
 		{
 			owner = _owner;
 		}
-		~Connection() {};
+		~Connection() {
+			timers.Cancel(idleTimer);
+			timers.Cancel(heartbeatTimer);
+
+			// Destroyed with its io_service without closing
+			if (established && !closed) {
+				metrics.activeConnections.Sub();
+			}
+		};
+
+		const ConnectionStats& Stats() const { return stats; }
+
+		// Created on the first call, _threadPool must outlive the work posted to it
+		std::shared_ptr<Pool::SerialExecutor> HandlerExecutor(Pool::ThreadPool& _threadPool) {
+			std::call_once(handlerExecutorOnce, [&]() { handlerExecutor = std::make_shared<Pool::SerialExecutor>(_threadPool); });
+			return handlerExecutor;
+		}
 
 		std::string GetAddressRemote() const { return connectSocket.remote_endpoint().address().to_string(); }
 		std::uint16_t GetPortRemote() const { return connectSocket.remote_endpoint().port(); }
@@ -49,92 +254,310 @@ namespace Net {
 		std::string GetAddressLocal() const { return connectSocket.local_endpoint().address().to_string(); }
 		std::uint16_t GetPortLocal() const { return connectSocket.local_endpoint().port(); }
 
+		// Set before the connection starts reading
+		void SetBodyConsumerFactory(BodyConsumerFactory _factory) {
+			bodyConsumerFactory = std::move(_factory);
+		}
+
+		// Set before the connection starts reading
+		void SetIncomingFilter(IncomingFilter _filter) {
+			incomingFilter = std::move(_filter);
+		}
+
+		// Set before the connection starts reading
+		void SetCloseHandler(CloseHandler _handler) {
+			closeHandler = std::move(_handler);
+		}
+
 		void ConnectToClient() {
 			if (owner == OwnerConnection::Server) {
 				if (IsConnected()) {
+					Establish();
 					ReadHeader();
 				}
 			}
 		}
 
-		void ConnectToServer(const asio::ip::tcp::resolver::results_type& _endpoint) {
+		// _onConnect runs on the io thread, also when Disconnect() cancels the attempt
+		void ConnectToServer(const asio::ip::tcp::resolver::results_type& _endpoint, std::function<void(ERROR_CODE)> _onConnect = nullptr) {
 			if (owner == OwnerConnection::Client) {
 				asio::async_connect(connectSocket, _endpoint,
-					[this](ERROR_CODE _error_code, ENDPOINT _endpoint) {
+					asio::bind_executor(strand, [this, self = this->shared_from_this(), onConnect = std::move(_onConnect)](ERROR_CODE _error_code, ENDPOINT _endpoint) {
+						if (!_error_code && closed) {
+							_error_code = asio::error::operation_aborted;
+						}
+
 						if (!_error_code) {
+							Establish();
 							ReadHeader();
 						}
-					}
+						else {
+							Close();
+						}
+
+						if (onConnect) {
+							onConnect(_error_code);
+						}
+					})
 				);
 			}
 		}
 
-		void Disconnect() {
-			if (IsConnected()) {
-				boost::asio::post(connectContext,
-					[this]() { connectSocket.close(); }
-				);
-			}
+		// Also cancels a connect in progress
+		// _onClosed runs on the io thread once the socket is closed and the close handler has run
+		void Disconnect(std::function<void()> _onClosed = nullptr) {
+			boost::asio::post(strand,
+				[this, self = this->shared_from_this(), onClosed = std::move(_onClosed)]() {
+					Close();
+					if (onClosed) {
+						onClosed();
+					}
+				}
+			);
 		}
 		bool IsConnected() {
 			return connectSocket.is_open();
 		}
 
 		void Send(const MessageIMPL& _msg) {
-			boost::asio::post(connectContext,
-				[this, _msg]()
+			MessageIMPL msg = _msg;
+			// Compression runs on the sending thread, the io thread only writes
+			CompressBody(msg);
+
+			boost::asio::post(strand,
+				[this, self = this->shared_from_this(), msg = std::move(msg)]() mutable
 				{
 					bool messageIsEmpty = msgQueueOut.empty();
-					msgQueueOut.push_back(_msg);
+					msgQueueOut.push_back(std::move(msg));
 					if (messageIsEmpty) {
 						WriteHeader();
 					}
 				}
 			);
 		}
+
+		void Send(std::vector<MessageIMPL> _msgs) {
+			for (MessageIMPL& msg : _msgs) {
+				CompressBody(msg);
+			}
+
+			boost::asio::post(strand,
+				[this, self = this->shared_from_this(), msgs = std::move(_msgs)]() mutable
+				{
+					bool messageIsEmpty = msgQueueOut.empty();
+					for (MessageIMPL& msg : msgs) {
+						msgQueueOut.push_back(std::move(msg));
+					}
+					if (messageIsEmpty && !msgQueueOut.empty()) {
+						WriteHeader();
+					}
+				}
+			);
+		}
+
+		/// Sends _msg with the range [_offset, _offset + _length) of the file at _path as
+		/// its body, a zero _length meaning to the end of the file. The peer receives an
+		/// ordinary message, large ones arrive through its body consumer. The range never
+		/// passes through a message buffer: Linux sends it from the page cache with
+		/// sendfile, Windows with TransmitFile, elsewhere and on file systems without
+		/// sendfile it is written from a read-only mapping.
+		/// Returns false without sending when the file cannot be opened or the range does
+		/// not fit in one frame. A body that fails halfway closes the connection.
+		bool SendFile(MessageIMPL _msg, const FileS::PathStruct& _path, std::uint64_t _offset = 0, std::uint64_t _length = 0,
+					  FileSentHandler _onSent = nullptr) {
+			auto transfer = std::make_unique<FileTransfer>();
+			transfer->path = _path;
+
+			std::uint64_t fileSize = 0;
+			if (!transfer->Open(fileSize) || _offset > fileSize) {
+				return false;
+			}
+			if (_length == 0 || _length > fileSize - _offset) {
+				_length = fileSize - _offset;
+			}
+			if (_length > Wire::kMaxBodyLength) {
+				return false;
+			}
+
+			transfer->offset = _offset;
+			transfer->remaining = _length;
+			transfer->onSent = std::move(_onSent);
+
+			_msg.Body().Clear();
+			_msg.Header().SetSize(static_cast<std::size_t>(_length));
+			_msg.Header().SetFlags((_msg.Header().Flags() & ~Wire::kFlagCompressed) | Wire::kFlagFileBody);
+
+			boost::asio::post(strand,
+				[this, self = this->shared_from_this(), msg = std::move(_msg), transfer = std::move(transfer)]() mutable
+				{
+					if (closed) {
+						if (transfer->onSent) {
+							transfer->onSent(asio::error::operation_aborted);
+						}
+						return;
+					}
+
+					bool messageIsEmpty = msgQueueOut.empty();
+					fileQueueOut.push_back(std::move(transfer));
+					msgQueueOut.push_back(std::move(msg));
+					if (messageIsEmpty) {
+						WriteHeader();
+					}
+				}
+			);
+			return true;
+		}
+
+		// The file _file was opened on, its stream position is not used
+		bool SendFile(MessageIMPL _msg, const FileS::FileIO& _file, std::uint64_t _offset = 0, std::uint64_t _length = 0,
+					  FileSentHandler _onSent = nullptr) {
+			return SendFile(std::move(_msg), _file.Path(), _offset, _length, std::move(_onSent));
+		}
 	private:
 		void ReadHeader() {
-			asio::async_read(connectSocket, boost::asio::buffer(&temporaryMessage.Header(), temporaryMessage.headerSize),
-				[this](ERROR_CODE _error_code, std::size_t _length)
+			asio::async_read(connectSocket, boost::asio::buffer(readHeaderBuffer),
+				asio::bind_executor(strand, [this, self = this->shared_from_this()](ERROR_CODE _error_code, std::size_t _length)
 				{
 					if (!_error_code) {
-						if (temporaryMessage.HSize() > 0) {
-							temporaryMessage.Body().Data().resize(temporaryMessage.HSize());
-							ReadBody();
+						lastReceive = TimerService::Clock::now();
+						CountReceived(_length);
+
+						if (!temporaryMessage.Header().Deserialize(readHeaderBuffer.data())) {
+							XLOG_WARN("Unsupported message header version {}", readHeaderBuffer[Wire::kOffsetVersion]);
+							Close();
+						}
+						else if (temporaryMessage.HSize() > 0) {
+							if (StartStream()) {
+								ReadBodyChunk();
+							}
+							else if (temporaryMessage.HSize() > options.maxFrameSize) {
+								XLOG_WARN("Message body of {} bytes exceeds the frame limit", temporaryMessage.HSize());
+								Close();
+							}
+							else {
+								temporaryMessage.Body().Data().resize(temporaryMessage.HSize());
+								ReadBody();
+							}
 						}
 						else {
 							AddMessageToQueue();
 						}
 					}
 					else {
-						connectSocket.close();
+						Close();
 					}
-				}
+				})
 			);
 		}
 		void ReadBody() {
-			asio::async_read(connectSocket, boost::asio::buffer(temporaryMessage.Body().Data(), temporaryMessage.HSize()),
-				[this](boost::system::error_code _error_code, std::size_t length)
+			// Read in pieces so a body that takes longer than idleTimeout is not closed while it still arrives
+			auto refreshIdle = [this, size = temporaryMessage.HSize()](const ERROR_CODE& _error_code, std::size_t _transferred) -> std::size_t {
+				if (_transferred > 0) {
+					lastReceive = TimerService::Clock::now();
+				}
+				return _error_code || _transferred >= size ? 0 : kBodyReadPiece;
+			};
+
+			asio::async_read(connectSocket, boost::asio::buffer(temporaryMessage.Body().Data(), temporaryMessage.HSize()), refreshIdle,
+				asio::bind_executor(strand, [this, self = this->shared_from_this()](boost::system::error_code _error_code, std::size_t length)
 				{
 					if (!_error_code) {
-						AddMessageToQueue();
+						lastReceive = TimerService::Clock::now();
+						CountReceived(length);
+
+						if (DecompressBody()) {
+							AddMessageToQueue();
+						}
+						else {
+							XLOG_WARN("Malformed compressed message body");
+							Close();
+						}
 					}
 					else {
-						connectSocket.close();
+						Close();
 					}
-				}
+				})
+			);
+		}
+
+		bool StartStream() {
+			if (options.streamThreshold == 0 || temporaryMessage.HSize() <= options.streamThreshold || !bodyConsumerFactory) {
+				return false;
+			}
+			// A compressed block can only be decoded whole
+			if (temporaryMessage.Header().Flags() & Wire::kFlagCompressed) {
+				return false;
+			}
+
+			bodyConsumer = bodyConsumerFactory(temporaryMessage);
+			if (!bodyConsumer) {
+				return false;
+			}
+
+			streamRemaining = temporaryMessage.HSize();
+			streamBuffer.resize(std::max<std::size_t>(options.streamChunkSize, 1));
+			return true;
+		}
+
+		void ReadBodyChunk() {
+			const std::size_t chunkSize = std::min(streamRemaining, streamBuffer.size());
+
+			asio::async_read(connectSocket, boost::asio::buffer(streamBuffer.data(), chunkSize),
+				asio::bind_executor(strand, [this, self = this->shared_from_this(), chunkSize](boost::system::error_code _error_code, std::size_t _length)
+				{
+					if (_error_code) {
+						Close();
+						return;
+					}
+
+					lastReceive = TimerService::Clock::now();
+					CountReceived(_length);
+					if (!bodyConsumer->OnChunk(streamBuffer.data(), chunkSize)) {
+						Close();
+						return;
+					}
+
+					streamRemaining -= chunkSize;
+					if (streamRemaining > 0) {
+						ReadBodyChunk();
+						return;
+					}
+
+					bodyConsumer->OnComplete();
+					bodyConsumer.reset();
+
+					temporaryMessage.Header().SetFlags(temporaryMessage.Header().Flags() | Wire::kFlagStreamed);
+					AddMessageToQueue();
+				})
 			);
 		}
 
 		void WriteHeader() {
-			asio::async_write(connectSocket, boost::asio::buffer(&msgQueueOut.front().Header(), msgQueueOut.front().headerSize),
-				[this](boost::system::error_code _error_code, std::size_t _length)
+			if (!msgQueueOut.front().Header().Serialize(writeHeaderBuffer.data())) {
+				XLOG_ERROR("Message of {} body bytes does not fit the wire header, dropped", msgQueueOut.front().HSize());
+				msgQueueOut.pop_front();
+
+				if (!msgQueueOut.empty()) {
+					WriteHeader();
+				}
+				return;
+			}
+
+			asio::async_write(connectSocket, boost::asio::buffer(writeHeaderBuffer),
+				asio::bind_executor(strand, [this, self = this->shared_from_this()](boost::system::error_code _error_code, std::size_t _length)
 				{
 					if (!_error_code) {
-						if (msgQueueOut.front().BSize() > 0) {
+						lastSend = TimerService::Clock::now();
+						CountSent(_length);
+
+						if (msgQueueOut.front().Header().Flags() & Wire::kFlagFileBody) {
+							WriteFileBody();
+						}
+						else if (msgQueueOut.front().BSize() > 0) {
 							WriteBody();
 						}
 						else {
+							CountMessageSent();
 							msgQueueOut.pop_front();
 
 							if (!msgQueueOut.empty()) {
@@ -143,16 +566,18 @@ namespace Net {
 						}
 					}
 					else {
-						connectSocket.close();
+						Close();
 					}
-				}
+				})
 			);
 		}
 		void WriteBody() {
 			asio::async_write(connectSocket, boost::asio::buffer(msgQueueOut.front().Body().Data(), msgQueueOut.front().BSize()),
-				[this](boost::system::error_code _error_code, std::size_t length)
+				asio::bind_executor(strand, [this, self = this->shared_from_this()](boost::system::error_code _error_code, std::size_t length)
 				{
 					if (!_error_code) {
+						CountSent(length);
+						CountMessageSent();
 						msgQueueOut.pop_front();
 
 						if (!msgQueueOut.empty()) {
@@ -160,14 +585,361 @@ namespace Net {
 						}
 					}
 					else {
-						connectSocket.close();
+						Close();
 					}
+				})
+			);
+		}
+
+		void WriteFileBody() {
+			FileTransfer& transfer = *fileQueueOut.front();
+			if (transfer.remaining == 0) {
+				FinishFile(ERROR_CODE());
+				return;
+			}
+			if (transfer.useMapping) {
+				WriteFileMapped();
+				return;
+			}
+
+#if defined(XPROJECT_HAS_SENDFILE)
+			// asio's own operations work with the socket in non-blocking mode as well
+			if (!connectSocket.native_non_blocking()) {
+				ERROR_CODE errorCode;
+				connectSocket.native_non_blocking(true, errorCode);
+				if (errorCode) {
+					FinishFile(errorCode);
+					return;
+				}
+			}
+
+			while (transfer.remaining > 0) {
+				off_t offset = static_cast<off_t>(transfer.offset);
+				const ssize_t sent = ::sendfile(connectSocket.native_handle(), transfer.fileDescriptor, &offset,
+					static_cast<std::size_t>(std::min(transfer.remaining, kMaxFileChunk)));
+
+				if (sent > 0) {
+					transfer.started = true;
+					transfer.offset += static_cast<std::uint64_t>(sent);
+					transfer.remaining -= static_cast<std::uint64_t>(sent);
+					lastSend = TimerService::Clock::now();
+					CountSent(static_cast<std::size_t>(sent));
+					continue;
+				}
+				if (sent < 0 && errno == EINTR) {
+					continue;
 				}
+				if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+					connectSocket.async_wait(SOCKET::wait_write,
+						asio::bind_executor(strand, [this, self = this->shared_from_this()](ERROR_CODE _error_code)
+						{
+							// Close already told the handler
+							if (closed) {
+								return;
+							}
+
+							if (!_error_code) {
+								WriteFileBody();
+							}
+							else {
+								FinishFile(_error_code);
+							}
+						})
+					);
+					return;
+				}
+				if (sent < 0 && (errno == EINVAL || errno == ENOSYS) && !transfer.started) {
+					transfer.useMapping = true;
+					WriteFileMapped();
+					return;
+				}
+
+				// A file cut shorter than the range cannot complete the frame
+				FinishFile(sent == 0 ? ERROR_CODE(asio::error::eof) : ERROR_CODE(errno, boost::system::system_category()));
+				return;
+			}
+			FinishFile(ERROR_CODE());
+#elif defined(XPROJECT_HAS_TRANSMITFILE)
+			const DWORD chunk = static_cast<DWORD>(std::min(transfer.remaining, kMaxFileChunk));
+
+			asio::windows::overlapped_ptr overlapped(connectSocket.get_executor(),
+				asio::bind_executor(strand, [this, self = this->shared_from_this()](ERROR_CODE _error_code, std::size_t _length)
+				{
+					if (closed) {
+						return;
+					}
+					if (_error_code) {
+						FinishFile(_error_code);
+						return;
+					}
+
+					FileTransfer& transfer = *fileQueueOut.front();
+					transfer.started = true;
+					transfer.offset += _length;
+					transfer.remaining -= _length;
+					lastSend = TimerService::Clock::now();
+					CountSent(_length);
+					WriteFileBody();
+				})
 			);
+
+			// The file position comes from the OVERLAPPED
+			overlapped.get()->Offset = static_cast<DWORD>(transfer.offset);
+			overlapped.get()->OffsetHigh = static_cast<DWORD>(transfer.offset >> 32);
+
+			const BOOL ok = ::TransmitFile(connectSocket.native_handle(), transfer.fileHandle, chunk, 0, overlapped.get(), nullptr, 0);
+			const DWORD lastError = ::GetLastError();
+			if (!ok && lastError != ERROR_IO_PENDING) {
+				overlapped.complete(ERROR_CODE(static_cast<int>(lastError), asio::error::get_system_category()), 0);
+			}
+			else {
+				overlapped.release();
+			}
+#else
+			WriteFileMapped();
+#endif
+		}
+
+		void WriteFileMapped() {
+			FileTransfer& transfer = *fileQueueOut.front();
+			if (!transfer.mapped.IsOpen() && !transfer.mapped.Open(transfer.path, FileS::MapMode::ReadOnly, FileS::AccessHint::Sequential)) {
+				FinishFile(asio::error::bad_descriptor);
+				return;
+			}
+
+			const std::span<const char> range = transfer.mapped.Span(transfer.offset, transfer.remaining);
+			if (range.size() < transfer.remaining) {
+				FinishFile(asio::error::eof);
+				return;
+			}
+
+			asio::async_write(connectSocket, boost::asio::buffer(range.data(), range.size()),
+				asio::bind_executor(strand, [this, self = this->shared_from_this()](ERROR_CODE _error_code, std::size_t _length)
+				{
+					CountSent(_length);
+					if (closed) {
+						return;
+					}
+
+					if (!_error_code) {
+						lastSend = TimerService::Clock::now();
+						fileQueueOut.front()->remaining = 0;
+					}
+					FinishFile(_error_code);
+				})
+			);
+		}
+
+		// The header is out, a failed body leaves the stream mid-frame and closes it
+		void FinishFile(ERROR_CODE _error_code) {
+			std::unique_ptr<FileTransfer> transfer = std::move(fileQueueOut.front());
+			fileQueueOut.pop_front();
+
+			if (transfer->onSent) {
+				transfer->onSent(_error_code);
+			}
+
+			if (_error_code) {
+				msgQueueOut.pop_front();
+				Close();
+				return;
+			}
+
+			CountMessageSent();
+			msgQueueOut.pop_front();
+			if (!msgQueueOut.empty()) {
+				WriteHeader();
+			}
+		}
+
+		void CompressBody(MessageIMPL& _msg) const {
+			const std::size_t bodySize = _msg.BSize();
+			if (options.compressionThreshold == 0 || bodySize < options.compressionThreshold || bodySize > Wire::kMaxBodyLength) {
+				return;
+			}
+			if (_msg.Header().Flags() & Wire::kFlagCompressed) {
+				return;
+			}
+
+			std::vector<byte_type> compressed(Wire::kCompressedPrefixSize + Utils::Compression::MaxCompressedSize(bodySize));
+			const std::size_t written = Utils::Compression::Compress(_msg.Body().Data().data(), bodySize,
+				compressed.data() + Wire::kCompressedPrefixSize, compressed.size() - Wire::kCompressedPrefixSize);
+
+			// Incompressible bodies go out as they are
+			if (written == 0 || Wire::kCompressedPrefixSize + written >= bodySize) {
+				return;
+			}
+
+			Wire::WriteU32(compressed.data(), static_cast<std::uint32_t>(bodySize));
+			compressed.resize(Wire::kCompressedPrefixSize + written);
+
+			_msg.Body().Data().swap(compressed);
+			_msg.Header().SetSize(_msg.BSize());
+			_msg.Header().SetFlags(_msg.Header().Flags() | Wire::kFlagCompressed);
+		}
+
+		bool DecompressBody() {
+			if (!(temporaryMessage.Header().Flags() & Wire::kFlagCompressed)) {
+				return true;
+			}
+
+			std::vector<byte_type>& data = temporaryMessage.Body().Data();
+			if (data.size() < Wire::kCompressedPrefixSize) {
+				return false;
+			}
+
+			const std::size_t rawSize = Wire::ReadU32(data.data());
+			if (rawSize > options.maxFrameSize) {
+				return false;
+			}
+
+			std::vector<byte_type> raw(rawSize);
+			if (!Utils::Compression::Decompress(data.data() + Wire::kCompressedPrefixSize, data.size() - Wire::kCompressedPrefixSize, raw.data(), rawSize)) {
+				return false;
+			}
+
+			data.swap(raw);
+			temporaryMessage.Header().SetSize(rawSize);
+			temporaryMessage.Header().SetFlags(temporaryMessage.Header().Flags() & ~Wire::kFlagCompressed);
+			return true;
+		}
+
+		// Runs on the strand, later calls do nothing
+		void Close() {
+			if (closed) {
+				return;
+			}
+			closed = true;
+
+			ERROR_CODE errorCode;
+			connectSocket.close(errorCode);
+
+			if (established) {
+				metrics.activeConnections.Sub();
+			}
+
+			timers.Cancel(idleTimer);
+			timers.Cancel(heartbeatTimer);
+
+			if (bodyConsumer) {
+				bodyConsumer->OnAbort();
+				bodyConsumer.reset();
+			}
+
+			for (std::unique_ptr<FileTransfer>& transfer : fileQueueOut) {
+				if (transfer->onSent) {
+					transfer->onSent(asio::error::operation_aborted);
+				}
+			}
+			fileQueueOut.clear();
+
+			if (established && closeHandler) {
+				// File messages have no body to resend, their handlers were told above
+				std::vector<MessageIMPL> unsent;
+				while (!msgQueueOut.empty()) {
+					MessageIMPL msg = msgQueueOut.pop_front();
+					if (!(msg.Header().Flags() & Wire::kFlagFileBody)) {
+						unsent.push_back(std::move(msg));
+					}
+				}
+				closeHandler(std::move(unsent));
+			}
+		}
+
+		void Establish() {
+			established = true;
+			metrics.activeConnections.Add();
+			StartTimers();
+		}
+
+		void CountReceived(std::size_t _bytes) {
+			stats.bytesReceived.fetch_add(_bytes, std::memory_order_relaxed);
+			metrics.bytesReceived.Add(_bytes);
+		}
+
+		void CountSent(std::size_t _bytes) {
+			stats.bytesSent.fetch_add(_bytes, std::memory_order_relaxed);
+			metrics.bytesSent.Add(_bytes);
+		}
+
+		void CountMessageSent() {
+			stats.messagesSent.fetch_add(1, std::memory_order_relaxed);
+			metrics.messagesSent.Add();
+		}
+
+		void StartTimers() {
+			lastReceive = lastSend = TimerService::Clock::now();
+
+			// Fired on the timer thread, the checks run on the strand
+			std::weak_ptr<Connection> weakSelf = this->weak_from_this();
+			if (options.idleTimeout.count() > 0) {
+				timers.Schedule(idleTimer, options.idleTimeout,
+					[weakSelf]() {
+						if (std::shared_ptr<Connection> self = weakSelf.lock()) {
+							boost::asio::post(self->strand, [self]() { self->CheckIdle(); });
+						}
+					}
+				);
+			}
+			if (options.heartbeatInterval.count() > 0) {
+				timers.Schedule(heartbeatTimer, options.heartbeatInterval,
+					[weakSelf]() {
+						if (std::shared_ptr<Connection> self = weakSelf.lock()) {
+							boost::asio::post(self->strand, [self]() { self->CheckHeartbeat(); });
+						}
+					}
+				);
+			}
+		}
+
+		void CheckIdle() {
+			if (closed) {
+				return;
+			}
+
+			const auto idle = TimerService::Clock::now() - lastReceive;
+			if (idle >= options.idleTimeout) {
+				XLOG_DEBUG("Closing connection idle for {} ms", std::chrono::duration_cast<std::chrono::milliseconds>(idle).count());
+				Close();
+				return;
+			}
+
+			// Activity does not touch the timer, it only moves the deadline checked here
+			timers.Schedule(idleTimer, options.idleTimeout - idle);
+		}
+
+		void CheckHeartbeat() {
+			if (closed) {
+				return;
+			}
+
+			const auto quiet = TimerService::Clock::now() - lastSend;
+			if (quiet < options.heartbeatInterval) {
+				timers.Schedule(heartbeatTimer, options.heartbeatInterval - quiet);
+				return;
+			}
+
+			if (msgQueueOut.empty()) {
+				MessageIMPL heartbeat;
+				heartbeat.Header().SetFlags(Wire::kFlagHeartbeat);
+
+				msgQueueOut.push_back(std::move(heartbeat));
+				WriteHeader();
+			}
+			timers.Schedule(heartbeatTimer, options.heartbeatInterval);
 		}
 
 		void AddMessageToQueue() {
-			if (owner == OwnerConnection::Server) {
+			stats.messagesReceived.fetch_add(1, std::memory_order_relaxed);
+			metrics.messagesReceived.Add();
+
+			if (temporaryMessage.Header().Flags() & Wire::kFlagHeartbeat) {
+				// Only refreshes lastReceive
+			}
+			else if (incomingFilter && incomingFilter(temporaryMessage)) {
+				// Taken by the filter
+			}
+			else if (owner == OwnerConnection::Server) {
 				msgQueueIn.push_back(std::make_shared<Net::OwnerMessage<MessageIMPL>>(this->shared_from_this(), temporaryMessage));
 			}
 			else {
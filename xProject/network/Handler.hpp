@@ -1,41 +1,253 @@
 #pragma once
 
+#include "network/Connection.hpp"
 #include "network/MessageInterface.hpp"
 #include "utils/ThreadPool.hpp"
+#include "utils/Coroutine.hpp"
+#include "utils/SerialExecutor.hpp"
+#include "utils/Log.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Timer.hpp"
 
 namespace Net {
 	template<typename MessageIMPL>
-	struct MessageHandler {
-		virtual MessageIMPL handle(Net::OWN_MSG_PTR<MessageIMPL> _msg) = 0;
-		virtual ~MessageHandler() = default;
+	struct IMessageHandler {
+		// Runs on a pool thread, _done must be called exactly once after the replies have been sent
+		virtual void Dispatch(Net::OWN_MSG_PTR<MessageIMPL> _msg, Pool::ThreadPool& _threadPool, std::function<void()> _done) = 0;
+		virtual ~IMessageHandler() = default;
 	};
 
+	namespace Detail {
+		// Runs a synchronous handler and calls _done even when it throws, the connection's
+		// executor stays held until then
+		template<typename Func>
+		void RunThenDone(Func&& _func, const std::function<void()>& _done) {
+			try {
+				_func();
+			}
+			catch (const std::exception& _error) {
+				XLOG_ERROR("Message handler failed: {}", _error.what());
+			}
+			catch (...) {
+				XLOG_ERROR("Message handler failed with unknown exception");
+			}
+			_done();
+		}
+	}
+
+	/// ReplyStream
+	/// ------------------------------------------------------------
+	/// Hands replies to the requesting connection as soon as they are produced.
+	/// A handler may send none, one or many messages.
+	template<typename MessageIMPL>
+	class ReplyStream {
+	private:
+		std::shared_ptr<Net::Connection<MessageIMPL>> connection;
+		std::uint32_t requestId = 0;
+		std::size_t sentCount = 0;
+
+	public:
+		explicit ReplyStream(std::shared_ptr<Net::Connection<MessageIMPL>> _connection, std::uint32_t _requestId = 0)
+			: connection(std::move(_connection)), requestId(_requestId) {}
+
+		// Replies of a call carry its request id unless the handler set one itself
+		explicit ReplyStream(const Net::OWN_MSG_PTR<MessageIMPL>& _request)
+			: ReplyStream(_request->remoteConnection, _request->remoteMsg.Header().RequestId()) {}
+
+		void Send(MessageIMPL _msg) {
+			if (connection) {
+				TagReply(_msg);
+				connection->Send(_msg);
+				sentCount++;
+			}
+		}
+
+		void Send(const std::optional<MessageIMPL>& _msg) {
+			if (_msg) {
+				Send(*_msg);
+			}
+		}
+
+		void Send(std::vector<MessageIMPL> _msgs) {
+			if (connection && !_msgs.empty()) {
+				for (MessageIMPL& msg : _msgs) {
+					TagReply(msg);
+				}
+				sentCount += _msgs.size();
+				connection->Send(std::move(_msgs));
+			}
+		}
+
+		std::size_t Count() const { return sentCount; }
+
+	private:
+		void TagReply(MessageIMPL& _msg) const {
+			if (_msg.Header().RequestId() == 0) {
+				_msg.Header().SetRequestId(requestId);
+			}
+		}
+	};
+
+	/// ReplyIMPL selects how many replies handle() produces:
+	/// MessageIMPL - exactly one, std::optional<MessageIMPL> - zero or one,
+	/// std::vector<MessageIMPL> - a batch written to the connection in one go
+	template<typename MessageIMPL, typename ReplyIMPL = MessageIMPL>
+	struct MessageHandler : IMessageHandler<MessageIMPL> {
+		virtual ReplyIMPL handle(Net::OWN_MSG_PTR<MessageIMPL> _msg) = 0;
+
+		void Dispatch(Net::OWN_MSG_PTR<MessageIMPL> _msg, Pool::ThreadPool& _threadPool, std::function<void()> _done) override {
+			Detail::RunThenDone(
+				[&]()
+				{
+					ReplyStream<MessageIMPL> replyStream(_msg);
+					replyStream.Send(handle(_msg));
+				},
+				_done
+			);
+		}
+	};
+
+	/// Writes replies into the stream while producing them, the first chunk leaves
+	/// before the last one is built
+	template<typename MessageIMPL>
+	struct StreamMessageHandler : IMessageHandler<MessageIMPL> {
+		virtual void handle(Net::OWN_MSG_PTR<MessageIMPL> _msg, ReplyStream<MessageIMPL>& _replyStream) = 0;
+
+		void Dispatch(Net::OWN_MSG_PTR<MessageIMPL> _msg, Pool::ThreadPool& _threadPool, std::function<void()> _done) override {
+			Detail::RunThenDone(
+				[&]()
+				{
+					ReplyStream<MessageIMPL> replyStream(_msg);
+					handle(_msg, replyStream);
+				},
+				_done
+			);
+		}
+	};
+
+	/// Replies with the metrics of Utils::MetricsRegistry::Global() as text, under the
+	/// message type the application registers it for
+	template<typename MessageIMPL>
+	struct StatsHandler : MessageHandler<MessageIMPL> {
+		explicit StatsHandler(Utils::MetricsFormat _format = Utils::MetricsFormat::JSON) : format(_format) {}
+
+		MessageIMPL handle(Net::OWN_MSG_PTR<MessageIMPL> _msg) override {
+			const std::string text = Utils::MetricsRegistry::Global().Export(format);
+
+			MessageIMPL reply;
+			reply.Header().SetType(_msg->remoteMsg.GetType());
+			reply.Body().Data().assign(text.begin(), text.end());
+			reply.Header().SetSize(reply.BSize());
+			return reply;
+		}
+
+	private:
+		Utils::MetricsFormat format;
+	};
+
+	/// Coroutine handler: suspends on co_await without holding a pool thread and is
+	/// resumed on the mediator's pool. Later messages of the same connection wait for it.
+	template<typename MessageIMPL, typename ReplyIMPL = MessageIMPL>
+	struct AsyncMessageHandler : IMessageHandler<MessageIMPL> {
+		virtual Pool::Task<ReplyIMPL> handle(Net::OWN_MSG_PTR<MessageIMPL> _msg) = 0;
+
+		void Dispatch(Net::OWN_MSG_PTR<MessageIMPL> _msg, Pool::ThreadPool& _threadPool, std::function<void()> _done) override {
+			Pool::Spawn(handle(_msg), _threadPool,
+				[_msg, _done](std::optional<ReplyIMPL> _replMsg)
+				{
+					if (_replMsg) {
+						ReplyStream<MessageIMPL> replyStream(_msg);
+						replyStream.Send(std::move(*_replMsg));
+					}
+					_done();
+				}
+			);
+		}
+	};
+
+	template<typename MessageIMPL>
+	struct AsyncStreamMessageHandler : IMessageHandler<MessageIMPL> {
+		// _replyStream stays valid until the returned task completes
+		virtual Pool::Task<void> handle(Net::OWN_MSG_PTR<MessageIMPL> _msg, ReplyStream<MessageIMPL>& _replyStream) = 0;
+
+		void Dispatch(Net::OWN_MSG_PTR<MessageIMPL> _msg, Pool::ThreadPool& _threadPool, std::function<void()> _done) override {
+			auto replyStream = std::make_shared<ReplyStream<MessageIMPL>>(_msg);
+
+			Pool::Spawn(handle(_msg, *replyStream), _threadPool,
+				[replyStream, _done](bool _completed)
+				{
+					_done();
+				}
+			);
+		}
+	};
+
+	/// co_await Net::Delay(context, 100ms) suspends a coroutine handler on an asio timer
+	template<typename Duration>
+	Pool::AsyncResult<void> Delay(asio::io_service& _context, Duration _duration) {
+		Pool::AsyncResult<void> result;
+
+		auto timer = std::make_shared<asio::steady_timer>(_context, _duration);
+		timer->async_wait(
+			[timer, result](ERROR_CODE _error_code)
+			{
+				result.Complete();
+			}
+		);
+		return result;
+	}
+
 	template<typename MessageIMPL, typename TypeMsg>
 	class HandlerMediator {
 	private:
-		std::unordered_map<TypeMsg, std::unique_ptr<MessageHandler<MessageIMPL>>> mapHandler;
+		std::unordered_map<TypeMsg, std::unique_ptr<IMessageHandler<MessageIMPL>>> mapHandler;
+
+		// Messages without a remote connection (client side) share this one
+		std::shared_ptr<Pool::SerialExecutor> detachedExecutor;
+
+		// From HandleMessage until a handler starts, and from there until it calls _done
+		Utils::LatencyHistogram queueLatency;
+		Utils::LatencyHistogram handleLatency;
+
+		// Declared last so its workers are joined before the members they use are destroyed
 		Pool::ThreadPool threadPool;
 	public:
 		
-		explicit HandlerMediator(const std::uint8_t& _threadCount) : threadPool{ _threadCount } {}
+		explicit HandlerMediator(const std::uint8_t& _threadCount) : threadPool{ _threadCount } {
+			detachedExecutor = std::make_shared<Pool::SerialExecutor>(threadPool);
+		}
 
-		void RegisterHandler(TypeMsg _msgType, std::unique_ptr<MessageHandler<MessageIMPL>> _handler) {
+		void RegisterHandler(TypeMsg _msgType, std::unique_ptr<IMessageHandler<MessageIMPL>> _handler) {
 			mapHandler[_msgType] = std::move(_handler);
 		}
 
 		void HandleMessage(Net::OWN_MSG_PTR<MessageIMPL> _ownMsg) {
 			if (mapHandler.find(_ownMsg->remoteMsg.GetType()) != mapHandler.end()) {
-				threadPool.Submit(&HandlerMediator::RunHandlers, this, _ownMsg);
+				// Messages of one connection are handled in arrival order, connections run in parallel
+				std::shared_ptr<Pool::SerialExecutor> executor = _ownMsg->remoteConnection
+					? _ownMsg->remoteConnection->HandlerExecutor(threadPool)
+					: detachedExecutor;
+				executor->Post(&HandlerMediator::RunHandlers, this, executor, _ownMsg, Utils::TscClock::now());
 			}
 		}
 
+		const Utils::LatencyHistogram& QueueLatency() const { return queueLatency; }
+		const Utils::LatencyHistogram& HandleLatency() const { return handleLatency; }
+
 	private:
+		void RunHandlers(std::shared_ptr<Pool::SerialExecutor> _executor, Net::OWN_MSG_PTR<MessageIMPL> _ownMsg, Utils::TscClock::time_point _posted) {
+			XLOG_TRACE("Thread: {}", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
-		void RunHandlers(Net::OWN_MSG_PTR<MessageIMPL> _ownMsg) {
-			spdlog::info("Thread: {}", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+			const Utils::TscClock::time_point started = Utils::TscClock::now();
+			queueLatency.Record(started - _posted);
 
-			MessageIMPL replMsg = mapHandler[_ownMsg->remoteMsg.GetType()]->handle(_ownMsg);
-			_ownMsg->remoteConnection->Send(replMsg);
+			mapHandler[_ownMsg->remoteMsg.GetType()]->Dispatch(_ownMsg, threadPool,
+				// A handler that suspends only holds back its own connection, the executor lives until it resumes
+				[this, started, _executor, done = _executor->Hold()]() {
+					handleLatency.Record(Utils::TscClock::now() - started);
+					done();
+				}
+			);
 		}
 	};
 
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include "network/MessageInterface.hpp"
+
+namespace Net {
+
+	enum class JsonFormat : std::uint8_t {
+		MessagePack, CBOR
+	};
+
+	/// JsonCodec
+	/// ------------------------------------------------------------
+	/// Binary JSON payloads, encoded straight into the body buffer and decoded from it
+	/// without the text round-trip of dump()/parse().
+	struct JsonCodec {
+		static void Encode(IBody& _body, const JSON& _json, JsonFormat _format = JsonFormat::MessagePack) {
+			// Keeps the buffer capacity when a body is reused
+			_body.Data().clear();
+
+			switch (_format) {
+			case JsonFormat::CBOR:
+				JSON::to_cbor(_json, _body.Data());
+				break;
+			case JsonFormat::MessagePack:
+				JSON::to_msgpack(_json, _body.Data());
+				break;
+			}
+		}
+
+		static bool Decode(IBody& _body, JSON& _json, JsonFormat _format = JsonFormat::MessagePack) {
+			const std::uint8_t* begin = _body.Data().data();
+			const std::uint8_t* end = begin + _body.Size();
+
+			switch (_format) {
+			case JsonFormat::CBOR:
+				_json = JSON::from_cbor(begin, end, true, false);
+				break;
+			case JsonFormat::MessagePack:
+				_json = JSON::from_msgpack(begin, end, true, false);
+				break;
+			}
+			return !_json.is_discarded();
+		}
+	};
+
+	template<typename MessageIMPL>
+	void EncodeJsonMessage(MessageIMPL& _msg, const JSON& _json, JsonFormat _format = JsonFormat::MessagePack) {
+		JsonCodec::Encode(_msg.Body(), _json, _format);
+		_msg.Header().SetSize(_msg.BSize());
+	}
+
+	template<typename MessageIMPL>
+	bool DecodeJsonMessage(MessageIMPL& _msg, JSON& _json, JsonFormat _format = JsonFormat::MessagePack) {
+		return JsonCodec::Decode(_msg.Body(), _json, _format);
+	}
+
+}
\ No newline at end of file
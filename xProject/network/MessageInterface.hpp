@@ -2,6 +2,12 @@
 
 #include <vector>
 #include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <boost/asio/detail/buffered_stream_storage.hpp>
+
+#include "network/WireFormat.hpp"
 
 namespace Net {
 
@@ -12,17 +18,66 @@ namespace Net {
 	protected:
 		TypeMsg type;
 		StatusMsg status;
+		std::uint8_t flags = 0;
+		std::uint32_t requestId = 0;
 
 		std::size_t sizeData = 0;
 	public:
+		// Type and status travel as 16-bit values
+		static constexpr std::size_t wireSize = Wire::kHeaderSize;
+
 		const std::size_t Size() const { return sizeData; }
 		void SetSize(std::size_t _size) { sizeData = _size; }
 
 		TypeMsg Type() const { return type; }
 		StatusMsg Status() const { return status; }
+		std::uint8_t Flags() const { return flags; }
+		std::uint32_t RequestId() const { return requestId; }
 
 		void SetType(TypeMsg _type) { type = _type; }
 		void SetStatus(StatusMsg _status) { status = _status; }
+		void SetFlags(std::uint8_t _flags) { flags = _flags; }
+		void SetRequestId(std::uint32_t _requestId) { requestId = _requestId; }
+
+		// False when the body is too long or type or status do not fit their 16 bits
+		bool Serialize(byte_type* _out) const {
+			if (sizeData > Wire::kMaxBodyLength || !std::in_range<std::uint16_t>(ToRaw(type)) || !std::in_range<std::uint16_t>(ToRaw(status))) {
+				return false;
+			}
+
+			_out[Wire::kOffsetVersion] = Wire::kVersion;
+			_out[Wire::kOffsetFlags] = flags & ~Wire::kLocalFlags;
+			Wire::WriteU16(_out + Wire::kOffsetType, static_cast<std::uint16_t>(type));
+			Wire::WriteU16(_out + Wire::kOffsetStatus, static_cast<std::uint16_t>(status));
+			Wire::WriteU32(_out + Wire::kOffsetLength, static_cast<std::uint32_t>(sizeData));
+			Wire::WriteU32(_out + Wire::kOffsetRequestId, requestId);
+			return true;
+		}
+
+		bool Deserialize(const byte_type* _in) {
+			if (_in[Wire::kOffsetVersion] != Wire::kVersion) {
+				return false;
+			}
+
+			flags = _in[Wire::kOffsetFlags] & ~Wire::kLocalFlags;
+			type = static_cast<TypeMsg>(Wire::ReadU16(_in + Wire::kOffsetType));
+			status = static_cast<StatusMsg>(Wire::ReadU16(_in + Wire::kOffsetStatus));
+			sizeData = Wire::ReadU32(_in + Wire::kOffsetLength);
+			requestId = Wire::ReadU32(_in + Wire::kOffsetRequestId);
+			return true;
+		}
+
+	private:
+		template<typename Value>
+		static constexpr auto ToRaw(Value _value) {
+			static_assert(std::is_integral_v<Value> || std::is_enum_v<Value>, "Message type and status must be integers or enums");
+			if constexpr (std::is_enum_v<Value>) {
+				return static_cast<std::underlying_type_t<Value>>(_value);
+			}
+			else {
+				return _value;
+			}
+		}
 	};
 
 	struct IBody {
@@ -43,7 +98,7 @@ namespace Net {
 		TypeHeader header{};
 		TypeBody body{};
 	public:
-		static constexpr size_t headerSize = sizeof(TypeHeader);
+		static constexpr size_t headerSize = TypeHeader::wireSize;
 
 		TypeHeader& Header() { return header; }
 		TypeBody& Body() { return body; }
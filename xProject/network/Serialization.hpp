@@ -0,0 +1,339 @@
+#pragma once
+
+#include <bit>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "network/MessageInterface.hpp"
+
+// Field list of a serializable struct, e.g. XSERIALIZE(id, name, values)
+#define XSERIALIZE(...) template<typename Archive> void Serialize(Archive& _archive) { _archive(__VA_ARGS__); }
+
+namespace Net {
+
+	/// Binary layout: scalars little-endian with their natural width, bool as one byte,
+	/// strings and ranges as a u32 length followed by the elements. Arrays of scalars are
+	/// aligned to the element size within the body so they can be read back as spans.
+	namespace Serial {
+
+		template<typename T>
+		struct IsVector : std::false_type {};
+		template<typename T, typename Alloc>
+		struct IsVector<std::vector<T, Alloc>> : std::true_type {};
+
+		template<typename T>
+		struct IsSpan : std::false_type {};
+		template<typename T, std::size_t Extent>
+		struct IsSpan<std::span<T, Extent>> : std::true_type {};
+
+		template<typename T>
+		constexpr bool kScalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+		// Ranges of these are copied as one block and can be viewed in place
+		template<typename T>
+		constexpr bool kBulk = kScalar<T> && !std::is_same_v<T, bool> && std::endian::native == std::endian::little;
+
+		template<typename T>
+		T ByteSwap(T _value) {
+			byte_type bytes[sizeof(T)];
+			std::memcpy(bytes, &_value, sizeof(T));
+			for (std::size_t i = 0; i < sizeof(T) / 2; i++) {
+				std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+			}
+			std::memcpy(&_value, bytes, sizeof(T));
+			return _value;
+		}
+
+		inline std::size_t Padding(std::size_t _position, std::size_t _alignment) {
+			return (_alignment - _position % _alignment) % _alignment;
+		}
+	}
+
+	/// BodyWriter
+	/// ------------------------------------------------------------
+	/// Writes values into a pre-sized buffer. Without a buffer it only measures,
+	/// which is how SerializeBody sizes the body with a single allocation.
+	class BodyWriter {
+	private:
+		byte_type* out = nullptr;
+		std::size_t position = 0;
+
+	public:
+		BodyWriter() = default;
+		explicit BodyWriter(byte_type* _out) : out(_out) {}
+
+		std::size_t Position() const { return position; }
+
+		template<typename... Values>
+		BodyWriter& operator()(const Values&... _values) {
+			(Write(_values), ...);
+			return *this;
+		}
+
+		template<typename Value>
+		BodyWriter& operator<<(const Value& _value) {
+			Write(_value);
+			return *this;
+		}
+
+	private:
+		void WriteBytes(const void* _data, std::size_t _size) {
+			if (out != nullptr && _size > 0) {
+				std::memcpy(out + position, _data, _size);
+			}
+			position += _size;
+		}
+
+		void Align(std::size_t _alignment) {
+			const std::size_t padding = Serial::Padding(position, _alignment);
+			if (out != nullptr) {
+				std::memset(out + position, 0, padding);
+			}
+			position += padding;
+		}
+
+		template<typename Scalar>
+		void WriteScalar(Scalar _value) {
+			if constexpr (std::endian::native != std::endian::little && sizeof(Scalar) > 1) {
+				_value = Serial::ByteSwap(_value);
+			}
+			WriteBytes(&_value, sizeof(Scalar));
+		}
+
+		void WriteLength(std::size_t _length) {
+			WriteScalar(static_cast<std::uint32_t>(_length));
+		}
+
+		template<typename Element>
+		void WriteRange(std::span<const Element> _range) {
+			WriteLength(_range.size());
+			if constexpr (Serial::kBulk<Element>) {
+				Align(alignof(Element));
+				WriteBytes(_range.data(), _range.size_bytes());
+			}
+			else {
+				for (const Element& element : _range) {
+					Write(element);
+				}
+			}
+		}
+
+		template<typename Value>
+		void Write(const Value& _value) {
+			if constexpr (std::is_same_v<Value, bool>) {
+				WriteScalar(static_cast<std::uint8_t>(_value ? 1 : 0));
+			}
+			else if constexpr (std::is_enum_v<Value>) {
+				WriteScalar(static_cast<std::underlying_type_t<Value>>(_value));
+			}
+			else if constexpr (std::is_arithmetic_v<Value>) {
+				WriteScalar(_value);
+			}
+			else if constexpr (std::is_convertible_v<const Value&, std::string_view>) {
+				const std::string_view view = _value;
+				WriteLength(view.size());
+				WriteBytes(view.data(), view.size());
+			}
+			else if constexpr (Serial::IsVector<Value>::value || Serial::IsSpan<Value>::value) {
+				using Element = std::remove_cv_t<typename Value::value_type>;
+				static_assert(!std::is_same_v<Element, bool>, "std::vector<bool> is not serializable");
+				WriteRange(std::span<const Element>(_value.data(), _value.size()));
+			}
+			else {
+				// Field lists declared with XSERIALIZE take the archive by non-const reference
+				const_cast<Value&>(_value).Serialize(*this);
+			}
+		}
+	};
+
+	/// BodyReader
+	/// ------------------------------------------------------------
+	/// Reads values back in the order they were written. std::string_view and
+	/// std::span<const T> read as views into the body, which must outlive them.
+	/// Any out-of-bounds read marks the reader invalid and leaves later values untouched.
+	class BodyReader {
+	private:
+		const byte_type* in = nullptr;
+		std::size_t size = 0;
+		std::size_t position = 0;
+		bool valid = true;
+
+	public:
+		BodyReader(const byte_type* _in, std::size_t _size) : in(_in), size(_size) {}
+		explicit BodyReader(IBody& _body) : in(_body.Data().data()), size(_body.Size()) {}
+
+		bool IsValid() const { return valid; }
+		std::size_t Position() const { return position; }
+		std::size_t Remaining() const { return size - position; }
+
+		template<typename... Values>
+		BodyReader& operator()(Values&... _values) {
+			(Read(_values), ...);
+			return *this;
+		}
+
+		template<typename Value>
+		BodyReader& operator>>(Value& _value) {
+			Read(_value);
+			return *this;
+		}
+
+	private:
+		const byte_type* Take(std::size_t _size) {
+			if (!valid || _size > Remaining()) {
+				valid = false;
+				return nullptr;
+			}
+
+			const byte_type* data = in + position;
+			position += _size;
+			return data;
+		}
+
+		bool Align(std::size_t _alignment) {
+			return Take(Serial::Padding(position, _alignment)) != nullptr;
+		}
+
+		template<typename Scalar>
+		bool ReadScalar(Scalar& _value) {
+			const byte_type* data = Take(sizeof(Scalar));
+			if (data == nullptr) {
+				return false;
+			}
+
+			std::memcpy(&_value, data, sizeof(Scalar));
+			if constexpr (std::endian::native != std::endian::little && sizeof(Scalar) > 1) {
+				_value = Serial::ByteSwap(_value);
+			}
+			return true;
+		}
+
+		bool ReadLength(std::size_t& _length) {
+			std::uint32_t length = 0;
+			if (!ReadScalar(length)) {
+				return false;
+			}
+			_length = length;
+			return true;
+		}
+
+		template<typename Value>
+		void Read(Value& _value) {
+			if (!valid) {
+				return;
+			}
+
+			if constexpr (std::is_same_v<Value, bool>) {
+				std::uint8_t flag = 0;
+				if (ReadScalar(flag)) {
+					_value = flag != 0;
+				}
+			}
+			else if constexpr (std::is_enum_v<Value>) {
+				std::underlying_type_t<Value> raw{};
+				if (ReadScalar(raw)) {
+					_value = static_cast<Value>(raw);
+				}
+			}
+			else if constexpr (std::is_arithmetic_v<Value>) {
+				ReadScalar(_value);
+			}
+			else if constexpr (std::is_same_v<Value, std::string_view> || std::is_same_v<Value, std::string>) {
+				std::size_t length = 0;
+				if (!ReadLength(length)) {
+					return;
+				}
+
+				const byte_type* data = Take(length);
+				if (data != nullptr) {
+					_value = Value(reinterpret_cast<const char*>(data), length);
+				}
+			}
+			else if constexpr (Serial::IsSpan<Value>::value) {
+				using Element = std::remove_cv_t<typename Value::element_type>;
+				static_assert(std::is_const_v<typename Value::element_type> && Serial::kBulk<Element>,
+							  "only std::span<const Scalar> can view the body");
+
+				std::size_t count = 0;
+				if (!ReadLength(count) || !Align(alignof(Element)) || count > Remaining() / sizeof(Element)) {
+					valid = false;
+					return;
+				}
+
+				const byte_type* data = Take(count * sizeof(Element));
+				_value = Value(reinterpret_cast<const Element*>(data), count);
+			}
+			else if constexpr (Serial::IsVector<Value>::value) {
+				using Element = typename Value::value_type;
+
+				std::size_t count = 0;
+				if (!ReadLength(count)) {
+					return;
+				}
+
+				if constexpr (Serial::kBulk<Element>) {
+					if (!Align(alignof(Element)) || count > Remaining() / sizeof(Element)) {
+						valid = false;
+						return;
+					}
+
+					const byte_type* data = Take(count * sizeof(Element));
+					_value.resize(count);
+					std::memcpy(_value.data(), data, count * sizeof(Element));
+				}
+				else {
+					// Every element takes at least one byte, rejects absurd counts before allocating
+					if (count > Remaining()) {
+						valid = false;
+						return;
+					}
+
+					_value.clear();
+					_value.reserve(count);
+					for (std::size_t i = 0; i < count && valid; i++) {
+						Read(_value.emplace_back());
+					}
+				}
+			}
+			else {
+				_value.Serialize(*this);
+			}
+		}
+	};
+
+	/// Encodes _values into _body with exactly one allocation
+	template<typename... Values>
+	void SerializeBody(IBody& _body, const Values&... _values) {
+		BodyWriter measure;
+		measure(_values...);
+
+		_body.Data().resize(measure.Position());
+
+		BodyWriter writer(_body.Data().data());
+		writer(_values...);
+	}
+
+	template<typename... Values>
+	bool DeserializeBody(IBody& _body, Values&... _values) {
+		BodyReader reader(_body);
+		reader(_values...);
+		return reader.IsValid();
+	}
+
+	/// Serializes into the message body and updates the header size
+	template<typename MessageIMPL, typename... Values>
+	void SerializeMessage(MessageIMPL& _msg, const Values&... _values) {
+		SerializeBody(_msg.Body(), _values...);
+		_msg.Header().SetSize(_msg.BSize());
+	}
+
+	template<typename MessageIMPL, typename... Values>
+	bool DeserializeMessage(MessageIMPL& _msg, Values&... _values) {
+		return DeserializeBody(_msg.Body(), _values...);
+	}
+
+}
\ No newline at end of file
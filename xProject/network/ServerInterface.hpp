@@ -4,59 +4,120 @@
 
 #include <spdlog/spdlog.h>
 #include <deque>
+#include <mutex>
 
 namespace Net {
 
+	struct ServerOptions {
+		std::string bindAddress = "127.0.0.1";
+		int backlog = asio::socket_base::max_listen_connections;
+
+		bool noDelay = false;
+		bool keepAlive = false;
+		// 0 keeps the system default, set on the listening socket so accepted sockets start with it
+		int sendBufferSize = 0;
+		int receiveBufferSize = 0;
+
+		// Threads running the io_service
+		std::size_t ioThreads = 1;
+		// Gives every io thread its own io_service and SO_REUSEPORT acceptor, the kernel spreads
+		// accepted connections between them. Without SO_REUSEPORT the threads share one acceptor.
+		bool reusePort = false;
+	};
+
 	template<typename MessageIMPL>
 	class ServerInterface {
 	protected:
-		std::deque<std::shared_ptr<Net::Connection<MessageIMPL>>> connections;
+		struct Listener {
+			asio::io_service connectContext;
+			asio::ip::tcp::acceptor acceptor{ connectContext };
+		};
+
+		// Outlive the connections and the queue they write to
+		std::vector<std::unique_ptr<Listener>> listeners;
 		Utils::QueueLF<std::shared_ptr<Net::OwnerMessage<MessageIMPL>>> msgQueueIn;
 
-		asio::io_service connectContext;
-		asio::ip::tcp::acceptor acceptor;
+		std::mutex connectionsMutex;
+		std::deque<std::shared_ptr<Net::Connection<MessageIMPL>>> connections;
+
+		std::vector<std::thread> threadsContext;
+
+		ServerOptions serverOptions;
+		ConnectionOptions connectionOptions;
+		typename Connection<MessageIMPL>::BodyConsumerFactory bodyConsumerFactory;
 
-		std::thread threadContext;
+		Utils::MetricsRegistry::Probe queueProbe;
+		Utils::MetricsRegistry::Probe connectionsProbe;
 
 	public:
-		ServerInterface(const uint16_t& _port) : acceptor(connectContext, ENDPOINT(asio::ip::address_v4::from_string("127.0.0.1"), _port)) {}
+		ServerInterface(const uint16_t& _port, const ServerOptions& _options = ServerOptions()) : serverOptions(_options)
+		{
+			const std::size_t ioThreads = std::max<std::size_t>(serverOptions.ioThreads, 1);
+#ifdef SO_REUSEPORT
+			const std::size_t listenerCount = serverOptions.reusePort ? ioThreads : 1;
+#else
+			const std::size_t listenerCount = 1;
+#endif
+
+			ENDPOINT endpoint(asio::ip::make_address(serverOptions.bindAddress), _port);
+			for (std::size_t i = 0; i < listenerCount; i++) {
+				listeners.push_back(std::make_unique<Listener>());
+				OpenAcceptor(listeners.back()->acceptor, endpoint);
+
+				// Port 0 picks a free port once, the other acceptors join it
+				endpoint = listeners.back()->acceptor.local_endpoint();
+			}
+
+			const std::string label = "{port=\"" + std::to_string(endpoint.port()) + "\"}";
+			queueProbe = Utils::MetricsRegistry::Global().AddProbe("net_server_queue_depth" + label, "Received messages not taken by Update yet",
+				[this]() { return static_cast<double>(msgQueueIn.size()); });
+			connectionsProbe = Utils::MetricsRegistry::Global().AddProbe("net_server_connections" + label, "Connections not yet collected by CheckClientConnection",
+				[this]() { return static_cast<double>(ConnectionCount()); });
+		}
 		~ServerInterface() { Stop(); }
 
 		void Start() 
 		{
 			WaitForClientConnection();
-			threadContext = std::thread([this]() { connectContext.run(); });
 
-			spdlog::info("Server Endpoint: {0}:{1}", acceptor.local_endpoint().address().to_string(), acceptor.local_endpoint().port());
+			const std::size_t ioThreads = std::max<std::size_t>(serverOptions.ioThreads, listeners.size());
+			for (std::size_t i = 0; i < ioThreads; i++) {
+				Listener& listener = *listeners[i % listeners.size()];
+				threadsContext.emplace_back([&listener]() { listener.connectContext.run(); });
+			}
+
+			spdlog::info("Server Endpoint: {0}:{1}", GetAddress(), GetPort());
 		}
 
-		void Stop() 
+		// Applies to connections accepted afterwards
+		void SetConnectionOptions(const ConnectionOptions& _options)
 		{
-			connectContext.stop();
-			if (threadContext.joinable()) { threadContext.join(); }
+			connectionOptions = _options;
 		}
 
-		void WaitForClientConnection() 
+		// Receives bodies above ConnectionOptions::streamThreshold of connections accepted afterwards
+		void SetBodyConsumerFactory(typename Connection<MessageIMPL>::BodyConsumerFactory _factory)
 		{
-			acceptor.async_accept(
-				[this](ERROR_CODE _error_code, SOCKET _socket)
-				{
-					if (!_error_code)
-					{
-						std::shared_ptr<Net::Connection<MessageIMPL>> clientConnection = std::make_shared<Net::Connection<MessageIMPL>>(Net::Connection<MessageIMPL>::OwnerConnection::Server, connectContext, std::move(_socket), msgQueueIn);
+			bodyConsumerFactory = std::move(_factory);
+		}
 
-						OnConnect(clientConnection);
+		void Stop() 
+		{
+			for (std::unique_ptr<Listener>& listener : listeners) {
+				listener->connectContext.stop();
+			}
 
-						connections.push_back(clientConnection);
-						connections.back()->ConnectToClient();
-					}
-					else {
-						// spdlog::warn("[Server] New Connection Error: {0}", _error_code.message());
-					}
+			for (std::thread& thread : threadsContext) {
+				if (thread.joinable()) { thread.join(); }
+			}
+			threadsContext.clear();
+		}
 
-					WaitForClientConnection();
-				}
-			);
+		void WaitForClientConnection() 
+		{
+			for (std::unique_ptr<Listener>& listener : listeners) {
+				Accept(*listener);
+			}
 		}
 
 		void Update(bool _wait = false) 
@@ -77,47 +138,114 @@ namespace Net {
 
 		void CheckClientConnection() 
 		{
-			bool invalidClient = false;
-			for (auto& client : connections) 
+			std::vector<std::shared_ptr<Net::Connection<MessageIMPL>>> closedClients;
 			{
-				if (client.get() == nullptr)
-				{
-					invalidClient = true;
-				}
-				else
+				std::lock_guard<std::mutex> lock(connectionsMutex);
+				for (auto& client : connections)
 				{
-					if (!client->IsConnected()) 
+					if (client != nullptr && !client->IsConnected())
 					{
-						OnDisconnect(client);
-						client.reset();
-
-						invalidClient = true;
+						closedClients.push_back(std::move(client));
 					}
 				}
+
+				connections.erase(std::remove(connections.begin(), connections.end(), nullptr), connections.end());
 			}
 
-			if (invalidClient)
+			for (auto& client : closedClients)
 			{
-				connections.erase(std::remove(connections.begin(), connections.end(), nullptr), connections.end());
+				OnDisconnect(client);
 			}
 		}
 
+		std::size_t ConnectionCount()
+		{
+			std::lock_guard<std::mutex> lock(connectionsMutex);
+			return connections.size();
+		}
+
 		std::string GetAddress() const
 		{
-			return acceptor.local_endpoint().address().to_string();
+			return listeners.front()->acceptor.local_endpoint().address().to_string();
 		}
 
 		std::uint16_t GetPort() const
 		{
-			return acceptor.local_endpoint().port();
+			return listeners.front()->acceptor.local_endpoint().port();
 		}
 
 	protected:
 		virtual void OnMessage(std::shared_ptr<Net::OwnerMessage<MessageIMPL>> _ownMsg) = 0;
 
+		// Called on an io thread, concurrently when there are several
 		virtual void OnConnect(std::shared_ptr<Net::Connection<MessageIMPL>> _handleClient) = 0;
 
 		virtual void OnDisconnect(std::shared_ptr<Net::Connection<MessageIMPL>> _handleClient) = 0;
+
+	private:
+		void OpenAcceptor(asio::ip::tcp::acceptor& _acceptor, const ENDPOINT& _endpoint)
+		{
+			_acceptor.open(_endpoint.protocol());
+			_acceptor.set_option(asio::socket_base::reuse_address(true));
+#ifdef SO_REUSEPORT
+			if (serverOptions.reusePort) {
+				_acceptor.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+			}
+#endif
+			if (serverOptions.sendBufferSize > 0) {
+				_acceptor.set_option(asio::socket_base::send_buffer_size(serverOptions.sendBufferSize));
+			}
+			if (serverOptions.receiveBufferSize > 0) {
+				_acceptor.set_option(asio::socket_base::receive_buffer_size(serverOptions.receiveBufferSize));
+			}
+
+			_acceptor.bind(_endpoint);
+			_acceptor.listen(serverOptions.backlog);
+		}
+
+		void TuneSocket(SOCKET& _socket)
+		{
+			ERROR_CODE errorCode;
+			if (serverOptions.noDelay) {
+				_socket.set_option(asio::ip::tcp::no_delay(true), errorCode);
+			}
+			if (serverOptions.keepAlive) {
+				_socket.set_option(asio::socket_base::keep_alive(true), errorCode);
+			}
+			if (errorCode) {
+				spdlog::warn("[Server] Socket option: {0}", errorCode.message());
+			}
+		}
+
+		void Accept(Listener& _listener)
+		{
+			_listener.acceptor.async_accept(
+				[this, &_listener](ERROR_CODE _error_code, SOCKET _socket)
+				{
+					if (!_error_code)
+					{
+						TuneSocket(_socket);
+
+						std::shared_ptr<Net::Connection<MessageIMPL>> clientConnection = std::make_shared<Net::Connection<MessageIMPL>>(Net::Connection<MessageIMPL>::OwnerConnection::Server, _listener.connectContext, std::move(_socket), msgQueueIn, connectionOptions);
+
+						clientConnection->SetBodyConsumerFactory(bodyConsumerFactory);
+
+						OnConnect(clientConnection);
+
+						{
+							std::lock_guard<std::mutex> lock(connectionsMutex);
+							connections.push_back(clientConnection);
+						}
+						clientConnection->ConnectToClient();
+					}
+					else {
+						// spdlog::warn("[Server] New Connection Error: {0}", _error_code.message());
+					}
+
+					Accept(_listener);
+				}
+			);
+		}
 	};
 
 }
\ No newline at end of file
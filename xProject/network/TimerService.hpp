@@ -0,0 +1,144 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "utils/Timer.hpp"
+
+namespace Net {
+
+	namespace asio = boost::asio;
+
+	/// TimerService
+	/// ------------------------------------------------------------
+	/// One Utils::TimerWheel per io_service, ticked every kResolution by a steady_timer
+	/// while any timer is pending. Schedule and Cancel may be called from any thread.
+	/// Callbacks run on an io thread outside the lock, so a timer cancelled while it is
+	/// already being fired may still run once.
+	class TimerService : public asio::detail::execution_context_service_base<TimerService> {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr std::chrono::milliseconds kResolution{ 10 };
+
+	private:
+		asio::strand<asio::io_service::executor_type> strand;
+		asio::steady_timer tickTimer;
+		const Clock::time_point start = Clock::now();
+
+		std::mutex mutex;
+		Utils::TimerWheel wheel;
+		bool ticking = false;
+		bool stopped = false;
+
+		// Only touched by the tick handler
+		std::vector<std::function<void()>> dueCallbacks;
+
+	public:
+		explicit TimerService(asio::execution_context& _context)
+			: execution_context_service_base<TimerService>(_context),
+			  strand(asio::make_strand(static_cast<asio::io_service&>(_context))), tickTimer(strand) {
+			// A node destroyed while scheduled cancels itself under this lock
+			wheel.SetGuard(&mutex);
+		}
+
+		static TimerService& For(asio::io_service& _context) {
+			return asio::use_service<TimerService>(_context);
+		}
+
+		/// Fires _node once after _delay, rounded up to kResolution. Rescheduling a
+		/// pending node moves it, destroying it cancels it.
+		void Schedule(Utils::TimerNode& _node, Clock::duration _delay) {
+			bool startTicking = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (stopped) {
+					return;
+				}
+
+				const std::uint64_t now = CurrentTick();
+				if (wheel.Empty()) {
+					// Nothing can fire, only moves the idle wheel up to date
+					wheel.Advance(now);
+				}
+
+				const std::uint64_t expiry = TickOf(Clock::now() + _delay);
+				wheel.Schedule(_node, expiry > wheel.Now() ? expiry - wheel.Now() : 1);
+
+				startTicking = !ticking;
+				ticking = true;
+			}
+
+			if (startTicking) {
+				asio::post(strand, [this]() { ArmTick(); });
+			}
+		}
+
+		void Schedule(Utils::TimerNode& _node, Clock::duration _delay, std::function<void()> _callback) {
+			_node.SetCallback(std::move(_callback));
+			Schedule(_node, _delay);
+		}
+
+		bool Cancel(Utils::TimerNode& _node) {
+			std::lock_guard<std::mutex> lock(mutex);
+			return wheel.Cancel(_node);
+		}
+
+		std::size_t Size() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return wheel.Size();
+		}
+
+	private:
+		void shutdown() override {
+			std::lock_guard<std::mutex> lock(mutex);
+			stopped = true;
+		}
+
+		std::uint64_t CurrentTick() const {
+			return static_cast<std::uint64_t>((Clock::now() - start) / kResolution);
+		}
+
+		// First tick at or after _time
+		std::uint64_t TickOf(Clock::time_point _time) const {
+			const Clock::duration sinceStart = _time - start;
+			return static_cast<std::uint64_t>((sinceStart + kResolution - Clock::duration(1)) / kResolution);
+		}
+
+		void ArmTick() {
+			tickTimer.expires_after(kResolution);
+			tickTimer.async_wait(
+				[this](boost::system::error_code _error_code) {
+					if (!_error_code) {
+						Tick();
+					}
+				}
+			);
+		}
+
+		void Tick() {
+			bool keepTicking = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				wheel.Advance(CurrentTick(), [this](Utils::TimerNode& _node) { dueCallbacks.push_back(_node.Callback()); });
+
+				ticking = !wheel.Empty() && !stopped;
+				keepTicking = ticking;
+			}
+
+			for (std::function<void()>& callback : dueCallbacks) {
+				callback();
+			}
+			dueCallbacks.clear();
+
+			if (keepTicking) {
+				ArmTick();
+			}
+		}
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Net {
+
+	namespace Wire {
+
+		using byte = unsigned char;
+
+		// Bumped on every incompatible change of the header layout
+		constexpr std::uint8_t kVersion = 2;
+
+		/// Header layout, all integers little-endian, no padding
+		/// ------------------------------------------------------------
+		///  0  u8   version
+		///  1  u8   flags
+		///  2  u16  type
+		///  4  u16  status
+		///  6  u32  body length
+		/// 10  u32  request id, 0 when the message is not part of a call
+		constexpr std::size_t kOffsetVersion = 0;
+		constexpr std::size_t kOffsetFlags = 1;
+		constexpr std::size_t kOffsetType = 2;
+		constexpr std::size_t kOffsetStatus = 4;
+		constexpr std::size_t kOffsetLength = 6;
+		constexpr std::size_t kOffsetRequestId = 10;
+		constexpr std::size_t kHeaderSize = 14;
+
+		constexpr std::uint64_t kMaxBodyLength = UINT32_MAX;
+
+		enum Flags : std::uint8_t {
+			// Body is the u32 uncompressed size followed by an LZ4 block
+			kFlagCompressed = 1 << 0,
+			// Keeps an idle connection alive, carries no body and is not delivered
+			kFlagHeartbeat = 1 << 1,
+			// Local only, never sent: the body is a file range written by Connection::SendFile
+			kFlagFileBody = 1 << 6,
+			// Local only, never sent: the body was delivered to an IBodyConsumer and is empty
+			kFlagStreamed = 1 << 7,
+		};
+
+		// Dropped from sent and received headers
+		constexpr std::uint8_t kLocalFlags = kFlagFileBody | kFlagStreamed;
+
+		constexpr std::size_t kCompressedPrefixSize = 4;
+
+		inline void WriteU16(byte* _out, std::uint16_t _value) {
+			_out[0] = static_cast<byte>(_value);
+			_out[1] = static_cast<byte>(_value >> 8);
+		}
+
+		inline void WriteU32(byte* _out, std::uint32_t _value) {
+			_out[0] = static_cast<byte>(_value);
+			_out[1] = static_cast<byte>(_value >> 8);
+			_out[2] = static_cast<byte>(_value >> 16);
+			_out[3] = static_cast<byte>(_value >> 24);
+		}
+
+		inline void WriteU64(byte* _out, std::uint64_t _value) {
+			WriteU32(_out, static_cast<std::uint32_t>(_value));
+			WriteU32(_out + 4, static_cast<std::uint32_t>(_value >> 32));
+		}
+
+		inline std::uint16_t ReadU16(const byte* _in) {
+			return static_cast<std::uint16_t>(_in[0] | (_in[1] << 8));
+		}
+
+		inline std::uint32_t ReadU32(const byte* _in) {
+			return static_cast<std::uint32_t>(_in[0])
+				| (static_cast<std::uint32_t>(_in[1]) << 8)
+				| (static_cast<std::uint32_t>(_in[2]) << 16)
+				| (static_cast<std::uint32_t>(_in[3]) << 24);
+		}
+
+		inline std::uint64_t ReadU64(const byte* _in) {
+			return static_cast<std::uint64_t>(ReadU32(_in)) | (static_cast<std::uint64_t>(ReadU32(_in + 4)) << 32);
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(_M_X64)
+	#include <intrin.h>
+	#define XPROJECT_HAS_CRC32C_DISPATCH 1
+	#define XPROJECT_TARGET_SSE42
+#elif defined(__GNUC__) && defined(__x86_64__)
+	#include <immintrin.h>
+	#define XPROJECT_HAS_CRC32C_DISPATCH 1
+	#define XPROJECT_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+namespace Utils
+{
+	namespace Checksum
+	{
+		// Reflected Castagnoli polynomial, the one iSCSI, ext4 and SSE4.2 use
+		constexpr std::uint32_t kCrc32cPolynomial = 0x82F63B78u;
+
+		namespace Detail
+		{
+			// Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes
+			constexpr std::array<std::array<std::uint32_t, 256>, 8> MakeCrc32cTables()
+			{
+				std::array<std::array<std::uint32_t, 256>, 8> tables{};
+				for (std::uint32_t byte = 0; byte < 256; byte++)
+				{
+					std::uint32_t crc = byte;
+					for (int bit = 0; bit < 8; bit++)
+					{
+						crc = (crc >> 1) ^ (kCrc32cPolynomial & (0u - (crc & 1u)));
+					}
+					tables[0][byte] = crc;
+				}
+				for (std::size_t k = 1; k < 8; k++)
+				{
+					for (std::uint32_t byte = 0; byte < 256; byte++)
+					{
+						tables[k][byte] = (tables[k - 1][byte] >> 8) ^ tables[0][tables[k - 1][byte] & 0xFF];
+					}
+				}
+				return tables;
+			}
+
+			inline constexpr auto kCrc32cTables = MakeCrc32cTables();
+
+			inline std::uint32_t Crc32cSoftware(std::uint32_t _crc, const unsigned char* _data, std::size_t _size)
+			{
+				const auto& t = kCrc32cTables;
+				while (_size >= 8)
+				{
+					std::uint32_t low;
+					std::uint32_t high;
+					std::memcpy(&low, _data, 4);
+					std::memcpy(&high, _data + 4, 4);
+					// The tables assume little-endian loads, as on every target of this project
+					low ^= _crc;
+					_crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+						t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+					_data += 8;
+					_size -= 8;
+				}
+				while (_size-- > 0)
+				{
+					_crc = (_crc >> 8) ^ t[0][(_crc ^ *_data++) & 0xFF];
+				}
+				return _crc;
+			}
+
+#ifdef XPROJECT_HAS_CRC32C_DISPATCH
+			inline bool CpuHasSse42()
+			{
+#ifdef _MSC_VER
+				int info[4];
+				__cpuid(info, 1);
+				return (info[2] & (1 << 20)) != 0;
+#else
+				return __builtin_cpu_supports("sse4.2");
+#endif
+			}
+
+			XPROJECT_TARGET_SSE42 inline std::uint32_t Crc32cHardware(std::uint32_t _crc, const unsigned char* _data, std::size_t _size)
+			{
+				std::uint64_t crc = _crc;
+				while (_size >= 8)
+				{
+					std::uint64_t word;
+					std::memcpy(&word, _data, 8);
+					crc = _mm_crc32_u64(crc, word);
+					_data += 8;
+					_size -= 8;
+				}
+				std::uint32_t crc32 = static_cast<std::uint32_t>(crc);
+				while (_size-- > 0)
+				{
+					crc32 = _mm_crc32_u8(crc32, *_data++);
+				}
+				return crc32;
+			}
+#endif
+		}
+
+		/// CRC-32C of _data. Pass the previous result as _crc to checksum a buffer in
+		/// pieces. Uses the SSE4.2 instruction when the CPU has it, tables otherwise.
+		inline std::uint32_t Crc32c(const void* _data, std::size_t _size, std::uint32_t _crc = 0)
+		{
+			const unsigned char* data = static_cast<const unsigned char*>(_data);
+			_crc = ~_crc;
+#ifdef XPROJECT_HAS_CRC32C_DISPATCH
+			static const bool hasSse42 = Detail::CpuHasSse42();
+			if (hasSse42)
+			{
+				return ~Detail::Crc32cHardware(_crc, data, _size);
+			}
+#endif
+			return ~Detail::Crc32cSoftware(_crc, data, _size);
+		}
+
+		inline std::uint32_t Crc32c(std::string_view _data, std::uint32_t _crc = 0)
+		{
+			return Crc32c(_data.data(), _data.size(), _crc);
+		}
+	}
+}
\ No newline at end of file
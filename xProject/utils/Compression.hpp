@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Define XPROJECT_USE_LZ4 and link liblz4 to use the reference implementation,
+// the built-in codec produces and accepts the same LZ4 block format
+#if defined(XPROJECT_USE_LZ4) && __has_include(<lz4.h>)
+	#include <lz4.h>
+	#define XPROJECT_HAS_LZ4 1
+#endif
+
+namespace Utils
+{
+	namespace Compression
+	{
+		constexpr std::size_t kMinMatch = 4;
+		// The block format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+		constexpr std::size_t kLastLiterals = 5;
+		constexpr std::size_t kMatchFindLimit = 12;
+		constexpr std::size_t kMaxOffset = 65535;
+		constexpr int kHashLog = 14;
+
+		inline std::size_t MaxCompressedSize(std::size_t _size)
+		{
+			return _size + _size / 255 + 16;
+		}
+
+		namespace Detail
+		{
+			inline std::uint32_t Read32(const std::uint8_t* _ptr)
+			{
+				std::uint32_t value;
+				std::memcpy(&value, _ptr, sizeof(value));
+				return value;
+			}
+
+			inline std::uint32_t Hash(std::uint32_t _sequence)
+			{
+				return (_sequence * 2654435761u) >> (32 - kHashLog);
+			}
+
+			// Writes the 255-run extension of a length field
+			inline std::uint8_t* WriteLength(std::uint8_t* _out, std::size_t _length)
+			{
+				while (_length >= 255)
+				{
+					*_out++ = 255;
+					_length -= 255;
+				}
+				*_out++ = static_cast<std::uint8_t>(_length);
+				return _out;
+			}
+
+			inline bool ReadLength(const std::uint8_t*& _in, const std::uint8_t* _end, std::size_t& _length)
+			{
+				std::uint8_t value;
+				do
+				{
+					if (_in >= _end)
+					{
+						return false;
+					}
+					value = *_in++;
+					_length += value;
+				} while (value == 255);
+				return true;
+			}
+
+			inline std::size_t CompressBlock(const std::uint8_t* _src, std::size_t _srcSize, std::uint8_t* _dst, std::size_t _dstCapacity)
+			{
+				std::uint8_t* out = _dst;
+				std::uint8_t* const outEnd = _dst + _dstCapacity;
+
+				std::size_t anchor = 0;
+				std::size_t position = 0;
+
+				if (_srcSize > kMatchFindLimit)
+				{
+					// Stale entries are harmless, every candidate is verified against the current input
+					thread_local std::vector<std::uint32_t> hashTable(std::size_t(1) << kHashLog, 0);
+
+					const std::size_t matchFindLimit = _srcSize - kMatchFindLimit;
+					const std::size_t matchEndLimit = _srcSize - kLastLiterals;
+
+					while (position < matchFindLimit)
+					{
+						const std::uint32_t sequence = Read32(_src + position);
+						const std::uint32_t hash = Hash(sequence);
+						std::size_t candidate = hashTable[hash];
+						hashTable[hash] = static_cast<std::uint32_t>(position);
+
+						if (candidate >= position || position - candidate > kMaxOffset || Read32(_src + candidate) != sequence)
+						{
+							// Skip faster through data that does not compress
+							position += 1 + ((position - anchor) >> 6);
+							continue;
+						}
+
+						while (position > anchor && candidate > 0 && _src[position - 1] == _src[candidate - 1])
+						{
+							position--;
+							candidate--;
+						}
+
+						std::size_t matchLength = kMinMatch;
+						while (position + matchLength < matchEndLimit && _src[candidate + matchLength] == _src[position + matchLength])
+						{
+							matchLength++;
+						}
+
+						const std::size_t literalLength = position - anchor;
+						const std::size_t sequenceBound = 1 + literalLength + literalLength / 255 + 1 + 2 + (matchLength - kMinMatch) / 255 + 1;
+						if (static_cast<std::size_t>(outEnd - out) < sequenceBound)
+						{
+							return 0;
+						}
+
+						std::uint8_t* token = out++;
+						if (literalLength >= 15)
+						{
+							*token = 15 << 4;
+							out = WriteLength(out, literalLength - 15);
+						}
+						else
+						{
+							*token = static_cast<std::uint8_t>(literalLength << 4);
+						}
+
+						std::memcpy(out, _src + anchor, literalLength);
+						out += literalLength;
+
+						const std::size_t offset = position - candidate;
+						*out++ = static_cast<std::uint8_t>(offset);
+						*out++ = static_cast<std::uint8_t>(offset >> 8);
+
+						const std::size_t extraLength = matchLength - kMinMatch;
+						if (extraLength >= 15)
+						{
+							*token |= 15;
+							out = WriteLength(out, extraLength - 15);
+						}
+						else
+						{
+							*token |= static_cast<std::uint8_t>(extraLength);
+						}
+
+						position += matchLength;
+						anchor = position;
+
+						if (position < matchFindLimit)
+						{
+							hashTable[Hash(Read32(_src + position - 2))] = static_cast<std::uint32_t>(position - 2);
+						}
+					}
+				}
+
+				const std::size_t literalLength = _srcSize - anchor;
+				if (static_cast<std::size_t>(outEnd - out) < 1 + literalLength + literalLength / 255 + 1)
+				{
+					return 0;
+				}
+
+				std::uint8_t* token = out++;
+				if (literalLength >= 15)
+				{
+					*token = 15 << 4;
+					out = WriteLength(out, literalLength - 15);
+				}
+				else
+				{
+					*token = static_cast<std::uint8_t>(literalLength << 4);
+				}
+
+				if (literalLength > 0)
+				{
+					std::memcpy(out, _src + anchor, literalLength);
+					out += literalLength;
+				}
+
+				return static_cast<std::size_t>(out - _dst);
+			}
+
+			inline bool DecompressBlock(const std::uint8_t* _src, std::size_t _srcSize, std::uint8_t* _dst, std::size_t _dstSize)
+			{
+				const std::uint8_t* in = _src;
+				const std::uint8_t* const inEnd = _src + _srcSize;
+				std::uint8_t* out = _dst;
+				std::uint8_t* const outEnd = _dst + _dstSize;
+
+				while (in < inEnd)
+				{
+					const std::uint8_t token = *in++;
+
+					std::size_t literalLength = token >> 4;
+					if (literalLength == 15 && !ReadLength(in, inEnd, literalLength))
+					{
+						return false;
+					}
+
+					if (static_cast<std::size_t>(inEnd - in) < literalLength || static_cast<std::size_t>(outEnd - out) < literalLength)
+					{
+						return false;
+					}
+
+					if (literalLength > 0)
+					{
+						std::memcpy(out, in, literalLength);
+						in += literalLength;
+						out += literalLength;
+					}
+
+					// The last sequence carries literals only
+					if (in == inEnd)
+					{
+						break;
+					}
+
+					if (inEnd - in < 2)
+					{
+						return false;
+					}
+
+					const std::size_t offset = in[0] | (in[1] << 8);
+					in += 2;
+					if (offset == 0 || offset > static_cast<std::size_t>(out - _dst))
+					{
+						return false;
+					}
+
+					std::size_t matchLength = token & 15;
+					if (matchLength == 15 && !ReadLength(in, inEnd, matchLength))
+					{
+						return false;
+					}
+					matchLength += kMinMatch;
+
+					if (static_cast<std::size_t>(outEnd - out) < matchLength)
+					{
+						return false;
+					}
+
+					const std::uint8_t* match = out - offset;
+					if (offset >= matchLength)
+					{
+						std::memcpy(out, match, matchLength);
+						out += matchLength;
+					}
+					else
+					{
+						// Overlapping copy repeats the last offset bytes
+						for (std::size_t i = 0; i < matchLength; i++)
+						{
+							*out++ = *match++;
+						}
+					}
+				}
+
+				return out == outEnd;
+			}
+		}
+
+		/// Compresses into _dst, returns the compressed size or 0 if it does not fit _dstCapacity
+		inline std::size_t Compress(const std::uint8_t* _src, std::size_t _srcSize, std::uint8_t* _dst, std::size_t _dstCapacity)
+		{
+#ifdef XPROJECT_HAS_LZ4
+			if (_srcSize <= LZ4_MAX_INPUT_SIZE)
+			{
+				const int written = LZ4_compress_default(reinterpret_cast<const char*>(_src), reinterpret_cast<char*>(_dst),
+					static_cast<int>(_srcSize), static_cast<int>(std::min<std::size_t>(_dstCapacity, INT32_MAX)));
+				return written > 0 ? static_cast<std::size_t>(written) : 0;
+			}
+#endif
+			return Detail::CompressBlock(_src, _srcSize, _dst, _dstCapacity);
+		}
+
+		/// Decompresses exactly _dstSize bytes, false on malformed input
+		inline bool Decompress(const std::uint8_t* _src, std::size_t _srcSize, std::uint8_t* _dst, std::size_t _dstSize)
+		{
+#ifdef XPROJECT_HAS_LZ4
+			if (_srcSize <= INT32_MAX && _dstSize <= INT32_MAX)
+			{
+				return LZ4_decompress_safe(reinterpret_cast<const char*>(_src), reinterpret_cast<char*>(_dst),
+					static_cast<int>(_srcSize), static_cast<int>(_dstSize)) == static_cast<int>(_dstSize);
+			}
+#endif
+			return Detail::DecompressBlock(_src, _srcSize, _dst, _dstSize);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <variant>
+
+#include "utils/ThreadPool.hpp"
+#include "utils/Log.hpp"
+
+namespace Pool {
+
+	template<typename Result>
+	class Task;
+
+	namespace Detail {
+
+		// Resumes _handle on _threadPool, or inline when the coroutine has no pool attached
+		inline void ResumeOn(ThreadPool* _threadPool, std::coroutine_handle<> _handle) {
+			if (_threadPool != nullptr) {
+				_threadPool->Submit([_handle]() { _handle.resume(); });
+			}
+			else {
+				_handle.resume();
+			}
+		}
+
+		struct PromiseBase {
+			ThreadPool* threadPool = nullptr;
+			std::coroutine_handle<> continuation;
+			std::exception_ptr error;
+
+			struct FinalAwaiter {
+				bool await_ready() noexcept { return false; }
+
+				template<typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> _handle) noexcept {
+					std::coroutine_handle<> continuation = _handle.promise().continuation;
+					if (continuation) {
+						return continuation;
+					}
+					return std::noop_coroutine();
+				}
+
+				void await_resume() noexcept {}
+			};
+
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		template<typename Result>
+		struct Promise : PromiseBase {
+			std::optional<Result> value;
+
+			Task<Result> get_return_object();
+
+			template<typename Value>
+			void return_value(Value&& _value) { value.emplace(std::forward<Value>(_value)); }
+
+			Result TakeResult() {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+				return std::move(*value);
+			}
+		};
+
+		template<>
+		struct Promise<void> : PromiseBase {
+			Task<void> get_return_object();
+
+			void return_void() {}
+
+			void TakeResult() {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			}
+		};
+
+		// Eager, self-destroying coroutine used to run a Task to completion without an awaiting parent
+		struct DetachedTask {
+			struct promise_type {
+				ThreadPool* threadPool = nullptr;
+
+				// Receives the coroutine arguments, the first one is the pool to run on
+				template<typename... Args>
+				explicit promise_type(ThreadPool& _threadPool, Args&...) : threadPool(&_threadPool) {}
+
+				DetachedTask get_return_object() { return {}; }
+				std::suspend_never initial_suspend() noexcept { return {}; }
+				std::suspend_never final_suspend() noexcept { return {}; }
+				void return_void() {}
+				void unhandled_exception() { std::terminate(); }
+			};
+		};
+	}
+
+	/// Task
+	/// ------------------------------------------------------------
+	/// Lazy coroutine result. Starts when awaited or spawned and inherits the
+	/// ThreadPool of its awaiter, suspended awaitables resume it on that pool.
+	template<typename Result>
+	class Task {
+	public:
+		using promise_type = Detail::Promise<Result>;
+
+	private:
+		std::coroutine_handle<promise_type> handle;
+
+	public:
+		explicit Task(std::coroutine_handle<promise_type> _handle) : handle(_handle) {}
+		~Task() {
+			if (handle) {
+				handle.destroy();
+			}
+		}
+
+		Task(Task&& _other) noexcept : handle(std::exchange(_other.handle, nullptr)) {}
+		Task& operator=(Task&& _other) noexcept {
+			if (this != &_other) {
+				if (handle) {
+					handle.destroy();
+				}
+				handle = std::exchange(_other.handle, nullptr);
+			}
+			return *this;
+		}
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		bool await_ready() const noexcept { return !handle || handle.done(); }
+
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> _awaiting) noexcept {
+			handle.promise().threadPool = _awaiting.promise().threadPool;
+			handle.promise().continuation = _awaiting;
+			return handle;
+		}
+
+		Result await_resume() { return handle.promise().TakeResult(); }
+	};
+
+	namespace Detail {
+		template<typename Result>
+		Task<Result> Promise<Result>::get_return_object() {
+			return Task<Result>(std::coroutine_handle<Promise<Result>>::from_promise(*this));
+		}
+
+		inline Task<void> Promise<void>::get_return_object() {
+			return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+		}
+
+		template<typename Result, typename OnDone>
+		DetachedTask RunDetached(ThreadPool&, Task<Result> _task, OnDone _onDone) {
+			if constexpr (std::is_void_v<Result>) {
+				bool completed = true;
+				try {
+					co_await _task;
+				}
+				catch (const std::exception& _error) {
+					XLOG_ERROR("Coroutine task failed: {}", _error.what());
+					completed = false;
+				}
+				catch (...) {
+					XLOG_ERROR("Coroutine task failed with unknown exception");
+					completed = false;
+				}
+				_onDone(completed);
+			}
+			else {
+				std::optional<Result> result;
+				try {
+					result.emplace(co_await _task);
+				}
+				catch (const std::exception& _error) {
+					XLOG_ERROR("Coroutine task failed: {}", _error.what());
+				}
+				catch (...) {
+					XLOG_ERROR("Coroutine task failed with unknown exception");
+				}
+				_onDone(std::move(result));
+			}
+		}
+
+		struct ScheduleAwaiter {
+			bool await_ready() const noexcept { return false; }
+
+			template<typename Promise>
+			void await_suspend(std::coroutine_handle<Promise> _awaiting) {
+				ResumeOn(_awaiting.promise().threadPool, _awaiting);
+			}
+
+			void await_resume() const noexcept {}
+		};
+	}
+
+	/// Starts _task on the calling thread with _threadPool attached. _onDone receives
+	/// std::optional<Result> (bool for Task<void>), empty/false if the task threw.
+	template<typename Result, typename OnDone>
+	void Spawn(Task<Result> _task, ThreadPool& _threadPool, OnDone&& _onDone) {
+		Detail::RunDetached(_threadPool, std::move(_task), std::forward<OnDone>(_onDone));
+	}
+
+	/// AsyncResult
+	/// ------------------------------------------------------------
+	/// One-shot value that can be completed from any thread and co_awaited once.
+	/// The awaiting coroutine is resumed on its own ThreadPool. After Fail the co_await
+	/// rethrows the exception instead of returning a value.
+	template<typename Result>
+	class AsyncResult {
+	private:
+		using Value = std::conditional_t<std::is_void_v<Result>, std::monostate, Result>;
+
+		enum State : int { kEmpty, kWaiting, kReady };
+
+		struct SharedState {
+			std::atomic<int> state = kEmpty;
+			std::optional<Value> value;
+			std::exception_ptr error;
+			std::coroutine_handle<> waiter;
+			ThreadPool* threadPool = nullptr;
+		};
+
+		std::shared_ptr<SharedState> sharedState = std::make_shared<SharedState>();
+
+	public:
+		AsyncResult() = default;
+
+		template<typename Value_ = Value>
+		void Complete(Value_&& _value) const requires (!std::is_void_v<Result>) {
+			sharedState->value.emplace(std::forward<Value_>(_value));
+			Publish();
+		}
+
+		void Complete() const requires std::is_void_v<Result> {
+			sharedState->value.emplace();
+			Publish();
+		}
+
+		void Fail(std::exception_ptr _error) const {
+			sharedState->error = std::move(_error);
+			Publish();
+		}
+
+		bool IsReady() const { return sharedState->state.load(std::memory_order_acquire) == kReady; }
+
+		bool await_ready() const noexcept { return IsReady(); }
+
+		template<typename Promise>
+		bool await_suspend(std::coroutine_handle<Promise> _awaiting) noexcept {
+			sharedState->waiter = _awaiting;
+			sharedState->threadPool = _awaiting.promise().threadPool;
+
+			int expected = kEmpty;
+			// Fails only if Complete already ran, continue without suspending
+			return sharedState->state.compare_exchange_strong(expected, kWaiting, std::memory_order_acq_rel);
+		}
+
+		Result await_resume() {
+			if (sharedState->error) {
+				std::rethrow_exception(sharedState->error);
+			}
+			if constexpr (!std::is_void_v<Result>) {
+				return std::move(*sharedState->value);
+			}
+		}
+
+	private:
+		void Publish() const {
+			if (sharedState->state.exchange(kReady, std::memory_order_acq_rel) == kWaiting) {
+				Detail::ResumeOn(sharedState->threadPool, sharedState->waiter);
+			}
+		}
+	};
+
+	/// Runs a blocking _func on _blockingPool and resumes the awaiting coroutine on its own
+	/// pool with the result, so a slow call never occupies a worker of the caller's pool
+	template<typename Func>
+	auto Offload(ThreadPool& _blockingPool, Func&& _func) {
+		using Result = std::invoke_result_t<Func>;
+
+		AsyncResult<Result> result;
+		_blockingPool.Submit(
+			[result, func = std::forward<Func>(_func)]()
+			{
+				// The exception is rethrown in the awaiting coroutine, which must resume either way
+				try {
+					if constexpr (std::is_void_v<Result>) {
+						func();
+						result.Complete();
+					}
+					else {
+						result.Complete(func());
+					}
+				}
+				catch (...) {
+					result.Fail(std::current_exception());
+				}
+			}
+		);
+		return result;
+	}
+
+	/// co_await Pool::Schedule() re-queues the coroutine on its ThreadPool, letting other work run
+	inline Detail::ScheduleAwaiter Schedule() {
+		return {};
+	}
+
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "network"
 #include "PeecStructMessage.hpp"
 #include "PeecThreadPool.hpp"
+#include "Log.hpp"
 
 namespace Net {
 	template<typename T>
@@ -33,7 +34,7 @@ namespace Net {
 	private:
 
 		void RunHandlers(Net::OWN_MSG_PTR<T> _ownMsg) {
-			spdlog::info("Thread: {}", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+			XLOG_TRACE("Thread: {}", std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
 			Net::Message<T> replMsg = mapHandler[_ownMsg->remoteMsg.GetType()]->handle(_ownMsg);
 			_ownMsg->remoteConnection->Send(replMsg);
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+// Compile-time log levels, values match spdlog::level::level_enum
+#define XLOG_LEVEL_TRACE 0
+#define XLOG_LEVEL_DEBUG 1
+#define XLOG_LEVEL_INFO 2
+#define XLOG_LEVEL_WARN 3
+#define XLOG_LEVEL_ERROR 4
+#define XLOG_LEVEL_CRITICAL 5
+#define XLOG_LEVEL_OFF 6
+
+// Calls below XLOG_ACTIVE_LEVEL expand to nothing, arguments are not evaluated
+#ifndef XLOG_ACTIVE_LEVEL
+	#ifdef NDEBUG
+		#define XLOG_ACTIVE_LEVEL XLOG_LEVEL_INFO
+	#else
+		#define XLOG_ACTIVE_LEVEL XLOG_LEVEL_TRACE
+	#endif
+#endif
+
+#if XLOG_ACTIVE_LEVEL <= XLOG_LEVEL_TRACE
+	#define XLOG_TRACE(...) spdlog::trace(__VA_ARGS__)
+#else
+	#define XLOG_TRACE(...) (void)0
+#endif
+
+#if XLOG_ACTIVE_LEVEL <= XLOG_LEVEL_DEBUG
+	#define XLOG_DEBUG(...) spdlog::debug(__VA_ARGS__)
+#else
+	#define XLOG_DEBUG(...) (void)0
+#endif
+
+#if XLOG_ACTIVE_LEVEL <= XLOG_LEVEL_INFO
+	#define XLOG_INFO(...) spdlog::info(__VA_ARGS__)
+#else
+	#define XLOG_INFO(...) (void)0
+#endif
+
+#if XLOG_ACTIVE_LEVEL <= XLOG_LEVEL_WARN
+	#define XLOG_WARN(...) spdlog::warn(__VA_ARGS__)
+#else
+	#define XLOG_WARN(...) (void)0
+#endif
+
+#if XLOG_ACTIVE_LEVEL <= XLOG_LEVEL_ERROR
+	#define XLOG_ERROR(...) spdlog::error(__VA_ARGS__)
+#else
+	#define XLOG_ERROR(...) (void)0
+#endif
+
+#if XLOG_ACTIVE_LEVEL <= XLOG_LEVEL_CRITICAL
+	#define XLOG_CRITICAL(...) spdlog::critical(__VA_ARGS__)
+#else
+	#define XLOG_CRITICAL(...) (void)0
+#endif
+
+namespace Utils
+{
+	struct LoggerOptions
+	{
+		std::string name = "xProject";
+
+		// Formatting and sink writes are moved to a background thread
+		bool async = false;
+		std::size_t asyncQueueSize = 8192;
+		std::size_t asyncThreadCount = 1;
+		// Drop the oldest queued record instead of blocking the caller when the queue is full
+		bool asyncOverrunOldest = true;
+	};
+
+	// Calling it again replaces the logger of the same name instead of failing to register it
+	inline std::shared_ptr<spdlog::logger> InitLogger(const LoggerOptions& _options = LoggerOptions())
+	{
+		if (std::shared_ptr<spdlog::logger> existing = spdlog::get(_options.name))
+		{
+			existing->flush();
+			spdlog::drop(_options.name);
+		}
+
+		std::shared_ptr<spdlog::logger> logger;
+		if (_options.async)
+		{
+			spdlog::init_thread_pool(_options.asyncQueueSize, _options.asyncThreadCount);
+
+			auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+			logger = std::make_shared<spdlog::async_logger>(_options.name, sink, spdlog::thread_pool(),
+				_options.asyncOverrunOldest ? spdlog::async_overflow_policy::overrun_oldest
+											: spdlog::async_overflow_policy::block);
+		}
+		else
+		{
+			logger = spdlog::stdout_color_mt(_options.name);
+		}
+
+		logger->set_level(static_cast<spdlog::level::level_enum>(XLOG_ACTIVE_LEVEL));
+		spdlog::set_default_logger(logger);
+
+		return logger;
+	}
+}
\ No newline at end of file
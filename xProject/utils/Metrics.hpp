@@ -0,0 +1,342 @@
+#pragma once
+
+#include "xProject_pch.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "utils/Timer.hpp"
+
+namespace Utils {
+
+	/// Counter
+	/// ------------------------------------------------------------
+	/// Monotonic count, sharded by thread so hot paths do not contend on one cache line
+	class Counter {
+	private:
+		static constexpr std::size_t kShards = 8;
+
+		struct alignas(64) Shard {
+			std::atomic<std::uint64_t> value{ 0 };
+		};
+
+		std::array<Shard, kShards> shards;
+
+	public:
+		void Add(std::uint64_t _amount = 1) {
+			shards[ThreadOrdinal() % kShards].value.fetch_add(_amount, std::memory_order_relaxed);
+		}
+
+		std::uint64_t Value() const {
+			std::uint64_t total = 0;
+			for (const Shard& shard : shards) {
+				total += shard.value.load(std::memory_order_relaxed);
+			}
+			return total;
+		}
+	};
+
+	/// Gauge
+	/// ------------------------------------------------------------
+	/// Value that goes up and down, such as open connections
+	class Gauge {
+	private:
+		std::atomic<std::int64_t> value{ 0 };
+
+	public:
+		void Set(std::int64_t _value) { value.store(_value, std::memory_order_relaxed); }
+		void Add(std::int64_t _amount = 1) { value.fetch_add(_amount, std::memory_order_relaxed); }
+		void Sub(std::int64_t _amount = 1) { value.fetch_sub(_amount, std::memory_order_relaxed); }
+
+		std::int64_t Value() const { return value.load(std::memory_order_relaxed); }
+	};
+
+	enum class MetricsFormat {
+		// Prometheus text exposition format, histograms as summaries in seconds
+		Prometheus,
+		JSON
+	};
+
+	/// MetricsRegistry
+	/// ------------------------------------------------------------
+	/// Named counters, gauges and latency histograms. Registration takes a lock and returns
+	/// a reference that stays valid for the life of the registry, callers keep it and
+	/// record without further lookups. A name may carry Prometheus labels, as in
+	/// "net_bytes_received_total{port=\"80\"}".
+	/// Probes are functions sampled at export time, for values that already exist
+	/// elsewhere such as queue sizes. They run outside the registry lock, so they may take
+	/// their own locks; removing a probe waits for a sample of it in progress.
+	class MetricsRegistry {
+	public:
+		/// Removes its probe on destruction
+		class Probe {
+		private:
+			friend class MetricsRegistry;
+
+			MetricsRegistry* registry = nullptr;
+			std::string name;
+
+			Probe(MetricsRegistry* _registry, std::string _name) : registry(_registry), name(std::move(_name)) {}
+
+		public:
+			Probe() = default;
+			~Probe() { Reset(); }
+
+			Probe(Probe&& _other) noexcept : registry(std::exchange(_other.registry, nullptr)), name(std::move(_other.name)) {}
+			Probe& operator=(Probe&& _other) noexcept {
+				if (this != &_other) {
+					Reset();
+					registry = std::exchange(_other.registry, nullptr);
+					name = std::move(_other.name);
+				}
+				return *this;
+			}
+
+			void Reset() {
+				if (registry != nullptr) {
+					registry->RemoveProbe(name);
+					registry = nullptr;
+				}
+			}
+		};
+
+	private:
+		template<typename Metric>
+		struct Entry {
+			std::string help;
+			std::unique_ptr<Metric> metric = std::make_unique<Metric>();
+		};
+
+		struct ProbeEntry {
+			std::string help;
+			std::function<double()> sample;
+			// Held while sampling, RemoveProbe takes it before the owner goes away
+			std::mutex sampling;
+			bool removed = false;
+		};
+
+		struct ProbeSample {
+			std::string name;
+			std::string help;
+			double value;
+		};
+
+		mutable std::mutex mutex;
+		std::map<std::string, Entry<Counter>> counters;
+		std::map<std::string, Entry<Gauge>> gauges;
+		std::map<std::string, Entry<LatencyHistogram>> histograms;
+		std::map<std::string, std::shared_ptr<ProbeEntry>> probes;
+
+	public:
+		MetricsRegistry() = default;
+		MetricsRegistry(const MetricsRegistry&) = delete;
+		MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+		// The registry the built-in instrumentation reports to
+		static MetricsRegistry& Global() {
+			static MetricsRegistry registry;
+			return registry;
+		}
+
+		Counter& GetCounter(const std::string& _name, const std::string& _help = "") {
+			return Get(counters, _name, _help);
+		}
+
+		Gauge& GetGauge(const std::string& _name, const std::string& _help = "") {
+			return Get(gauges, _name, _help);
+		}
+
+		LatencyHistogram& GetHistogram(const std::string& _name, const std::string& _help = "") {
+			return Get(histograms, _name, _help);
+		}
+
+		// Replaces a probe of the same name
+		[[nodiscard]] Probe AddProbe(const std::string& _name, const std::string& _help, std::function<double()> _sample) {
+			auto entry = std::make_shared<ProbeEntry>();
+			entry->help = _help;
+			entry->sample = std::move(_sample);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			probes[_name] = std::move(entry);
+			return Probe(this, _name);
+		}
+
+		std::string Export(MetricsFormat _format) const {
+			return _format == MetricsFormat::JSON ? ExportJSON().dump(1, '\t') : ExportPrometheus();
+		}
+
+		std::string ExportPrometheus() const {
+			const std::vector<ProbeSample> samples = SampleProbes();
+			std::lock_guard<std::mutex> lock(mutex);
+
+			std::ostringstream out;
+			std::string lastFamily;
+
+			for (const auto& [name, entry] : counters) {
+				WriteFamily(out, lastFamily, name, entry.help, "counter");
+				out << name << ' ' << entry.metric->Value() << '\n';
+			}
+			for (const auto& [name, entry] : gauges) {
+				WriteFamily(out, lastFamily, name, entry.help, "gauge");
+				out << name << ' ' << entry.metric->Value() << '\n';
+			}
+			for (const ProbeSample& sample : samples) {
+				WriteFamily(out, lastFamily, sample.name, sample.help, "gauge");
+				out << sample.name << ' ' << sample.value << '\n';
+			}
+			for (const auto& [name, entry] : histograms) {
+				WriteFamily(out, lastFamily, name, entry.help, "summary");
+
+				const LatencySnapshot snapshot = entry.metric->Snapshot();
+				const std::string family = FamilyOf(name);
+				const std::string labels = LabelsOf(name);
+
+				for (double quantile : { 0.5, 0.9, 0.99, 0.999 }) {
+					out << family << '{' << labels << (labels.empty() ? "" : ",") << "quantile=\"" << quantile << "\"} "
+						<< Seconds(snapshot.Percentile(quantile * 100.0)) << '\n';
+				}
+				const std::string suffixLabels = labels.empty() ? "" : "{" + labels + "}";
+				out << family << "_sum" << suffixLabels << ' ' << Seconds(snapshot.Sum()) << '\n';
+				out << family << "_count" << suffixLabels << ' ' << snapshot.Count() << '\n';
+			}
+
+			return out.str();
+		}
+
+		JSON ExportJSON() const {
+			const std::vector<ProbeSample> samples = SampleProbes();
+			std::lock_guard<std::mutex> lock(mutex);
+
+			JSON json = JSON::object();
+			for (const auto& [name, entry] : counters) {
+				json["counters"][name] = entry.metric->Value();
+			}
+			for (const auto& [name, entry] : gauges) {
+				json["gauges"][name] = entry.metric->Value();
+			}
+			for (const ProbeSample& sample : samples) {
+				json["gauges"][sample.name] = sample.value;
+			}
+			for (const auto& [name, entry] : histograms) {
+				const LatencySnapshot snapshot = entry.metric->Snapshot();
+				json["histograms"][name] = {
+					{ "count", snapshot.Count() },
+					{ "min_ns", snapshot.Min().count() },
+					{ "mean_ns", snapshot.Mean().count() },
+					{ "p50_ns", snapshot.Percentile(50.0).count() },
+					{ "p90_ns", snapshot.Percentile(90.0).count() },
+					{ "p99_ns", snapshot.Percentile(99.0).count() },
+					{ "p999_ns", snapshot.Percentile(99.9).count() },
+					{ "max_ns", snapshot.Max().count() }
+				};
+			}
+			return json;
+		}
+
+		/// Writes the export next to _path and renames it over _path, so a reader such as
+		/// the node_exporter textfile collector never sees a partial file
+		bool WriteToFile(const std::string& _path, MetricsFormat _format = MetricsFormat::Prometheus) const {
+			const std::string content = Export(_format);
+			const std::string temporaryPath = _path + ".tmp";
+
+			{
+				std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+				if (!file.write(content.data(), static_cast<std::streamsize>(content.size()))) {
+					return false;
+				}
+			}
+
+			if (std::rename(temporaryPath.c_str(), _path.c_str()) == 0) {
+				return true;
+			}
+			// The CRT rename does not replace an existing file
+			std::remove(_path.c_str());
+			return std::rename(temporaryPath.c_str(), _path.c_str()) == 0;
+		}
+
+	private:
+		template<typename Metric>
+		Metric& Get(std::map<std::string, Entry<Metric>>& _map, const std::string& _name, const std::string& _help) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Entry<Metric>& entry = _map[_name];
+			if (entry.help.empty()) {
+				entry.help = _help;
+			}
+			return *entry.metric;
+		}
+
+		void RemoveProbe(const std::string& _name) {
+			std::shared_ptr<ProbeEntry> entry;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto found = probes.find(_name);
+				if (found == probes.end()) {
+					return;
+				}
+				entry = std::move(found->second);
+				probes.erase(found);
+			}
+
+			std::lock_guard<std::mutex> sampling(entry->sampling);
+			entry->removed = true;
+		}
+
+		// Samples without the registry lock, a probe may take a lock under which its owner
+		// registers metrics
+		std::vector<ProbeSample> SampleProbes() const {
+			std::vector<std::pair<std::string, std::shared_ptr<ProbeEntry>>> listed;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				listed.assign(probes.begin(), probes.end());
+			}
+
+			std::vector<ProbeSample> samples;
+			samples.reserve(listed.size());
+			for (const auto& [name, entry] : listed) {
+				std::lock_guard<std::mutex> sampling(entry->sampling);
+				if (!entry->removed) {
+					samples.push_back(ProbeSample{ name, entry->help, entry->sample() });
+				}
+			}
+			return samples;
+		}
+
+		static std::string FamilyOf(const std::string& _name) {
+			return _name.substr(0, _name.find('{'));
+		}
+
+		static std::string LabelsOf(const std::string& _name) {
+			const std::size_t open = _name.find('{');
+			if (open == std::string::npos) {
+				return {};
+			}
+			const std::size_t close = _name.rfind('}');
+			return _name.substr(open + 1, close == std::string::npos || close < open ? std::string::npos : close - open - 1);
+		}
+
+		// HELP and TYPE once per family, the maps keep a family's labelled series together
+		static void WriteFamily(std::ostringstream& _out, std::string& _lastFamily, const std::string& _name, const std::string& _help, const char* _type) {
+			std::string family = FamilyOf(_name);
+			if (family == _lastFamily) {
+				return;
+			}
+
+			if (!_help.empty()) {
+				_out << "# HELP " << family << ' ' << _help << '\n';
+			}
+			_out << "# TYPE " << family << ' ' << _type << '\n';
+			_lastFamily = std::move(family);
+		}
+
+		static double Seconds(std::chrono::nanoseconds _value) {
+			return std::chrono::duration<double>(_value).count();
+		}
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "collections/QeueuLockfree.hpp"
+#include "utils/Log.hpp"
+#include "utils/ThreadPool.hpp"
+
+namespace Pool {
+
+	/// SerialExecutor
+	/// ------------------------------------------------------------
+	/// Runs posted tasks one at a time and in posting order on top of a shared ThreadPool.
+	/// Different executors on the same pool run in parallel.
+	class SerialExecutor {
+	private:
+		using Task = std::function<void()>;
+
+		// Tasks executed by one drain before it yields the worker back to the pool
+		static constexpr std::size_t kDrainBatch = 64;
+
+		// Hold() handshake between the running task and the drain loop
+		enum HoldState : int { kHoldNone, kHoldRequested, kHoldParked };
+
+		ThreadPool& threadPool;
+		Utils::QueueLF<Task> tasks;
+		std::atomic<std::size_t> pending = 0;
+		std::atomic<int> holdState = kHoldNone;
+
+	public:
+		explicit SerialExecutor(ThreadPool& _threadPool) : threadPool(_threadPool) {}
+
+		SerialExecutor(const SerialExecutor&) = delete;
+		SerialExecutor& operator=(const SerialExecutor&) = delete;
+
+		template<typename Func, typename... Args>
+		void Post(Func&& _func, Args&&... _args) {
+			tasks.push_back(
+				[f = std::forward<Func>(_func),
+				 args = std::tuple(std::forward<Args>(_args)...)]() mutable
+				{
+					std::apply(f, args);
+				}
+			);
+
+			// The producer that makes the executor non-empty schedules the drain
+			if (pending.fetch_add(1, std::memory_order_acq_rel) == 0) {
+				threadPool.Submit(&SerialExecutor::Drain, this);
+			}
+		}
+
+		/// Called from inside a running task: the executor stays occupied until the returned
+		/// callback is invoked (exactly once, from any thread), so later tasks keep waiting
+		/// for asynchronous work started by this one
+		std::function<void()> Hold() {
+			holdState.store(kHoldRequested, std::memory_order_release);
+			return [this]() { Release(); };
+		}
+
+		bool Idle() const {
+			return pending.load(std::memory_order_acquire) == 0;
+		}
+
+	private:
+		void Release() {
+			// The drain already left the task parked, continue in its place
+			if (holdState.exchange(kHoldNone, std::memory_order_acq_rel) == kHoldParked) {
+				if (pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+					threadPool.Submit(&SerialExecutor::Drain, this);
+				}
+			}
+		}
+
+		void Drain() {
+			std::size_t executed = 0;
+			while (true) {
+				Task task = tasks.pop_front();
+				if (task) {
+					// A throwing task must not skip the bookkeeping below, the executor would stay busy forever
+					try {
+						task();
+					}
+					catch (const std::exception& _error) {
+						XLOG_ERROR("Serial executor task failed: {}", _error.what());
+					}
+					catch (...) {
+						XLOG_ERROR("Serial executor task failed with unknown exception");
+					}
+				}
+
+				int expected = kHoldRequested;
+				if (holdState.compare_exchange_strong(expected, kHoldParked, std::memory_order_acq_rel)) {
+					return;
+				}
+
+				if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					return;
+				}
+
+				if (++executed == kDrainBatch) {
+					threadPool.Submit(&SerialExecutor::Drain, this);
+					return;
+				}
+			}
+		}
+	};
+
+}
\ No newline at end of file
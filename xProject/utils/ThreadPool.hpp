@@ -7,16 +7,39 @@
 #include <utility>
 
 #include "collections/QeueuLockfree.hpp"
+#include "utils/Metrics.hpp"
 #include "Utils.hpp"
 
 namespace Pool {
 
 	class ThreadTaskBase {
 	public:
+		// Left unset when the pool does not time its tasks
+		Utils::TscClock::time_point submitted{};
+
 		virtual ~ThreadTaskBase() {}
 		virtual void Execute() = 0;
 	};
 
+	/// Totals of all pools in Utils::MetricsRegistry::Global()
+	struct PoolMetrics {
+		Utils::Gauge& tasksQueued;
+		Utils::LatencyHistogram& taskWait;
+		Utils::LatencyHistogram& taskRun;
+
+		static PoolMetrics& Get() {
+			static PoolMetrics metrics = []() {
+				Utils::MetricsRegistry& registry = Utils::MetricsRegistry::Global();
+				return PoolMetrics{
+					registry.GetGauge("pool_tasks_queued", "Tasks submitted and not started yet"),
+					registry.GetHistogram("pool_task_wait_seconds", "Time from Submit until a thread starts the task"),
+					registry.GetHistogram("pool_task_run_seconds", "Time a task runs")
+				};
+			}();
+			return metrics;
+		}
+	};
+
 	/// ThreadTask
 	/// ------------------------------------------------------------
 	template<typename Result>
@@ -63,9 +86,18 @@ namespace Pool {
 		std::atomic_bool stopThreads = false;
 		std::vector<std::thread> threads;
 		Utils::QueueLF<TaskPtrBase> tasks;
+		PoolMetrics& metrics = PoolMetrics::Get();
+		// Two clock reads and two histogram records per task, for pools of very short tasks
+		// that is worth turning off
+		const bool timeTasks;
 
 	public:
-		explicit ThreadPool(DWORD _numThread) {
+		explicit ThreadPool(DWORD _numThread, bool _timeTasks = true) : timeTasks(_timeTasks) {
+			if (timeTasks) {
+				// Calibrates the clock here instead of stalling the first submitting thread
+				Utils::TscClock::now();
+			}
+
 			threads.reserve(_numThread);
 			for (DWORD i = 0; i < _numThread; i++) {
 				threads.emplace_back(&ThreadPool::WaitForWork, this);
@@ -80,12 +112,20 @@ namespace Pool {
 		auto Submit(Func&& _func, Args&&... _args) {
 			auto task = Pool::MakeTask(std::forward<Func>(_func), std::forward<Args>(_args)...);
 			auto taskFuture = task->GetFuture();
+			if (timeTasks) {
+				task->submitted = Utils::TscClock::now();
+			}
 			
+			metrics.tasksQueued.Add();
 			tasks.push_back(std::move(task));
 			
 			return taskFuture;
 		}
 
+		std::size_t Queued() const {
+			return tasks.size();
+		}
+
 		void Join() {
 			tasks.stop_wait();
 			Destroy();
@@ -98,7 +138,18 @@ namespace Pool {
 
 				TaskPtrBase task = std::move(tasks.pop_front());
 				if (task.get() != nullptr) {
+					metrics.tasksQueued.Sub();
+
+					if (!timeTasks) {
+						task->Execute();
+						continue;
+					}
+
+					Utils::TscClock::time_point started = Utils::TscClock::now();
+					metrics.taskWait.Record(started - task->submitted);
+
 					task->Execute();
+					metrics.taskRun.Record(Utils::TscClock::now() - started);
 				}
 
 			}
@@ -112,6 +163,13 @@ namespace Pool {
 					thread.join();
 				}
 			}
+
+			// Dropped without running, taken out of the queue so a later Destroy does not count them again
+			std::int64_t dropped = 0;
+			while (tasks.pop_front() != nullptr) {
+				dropped++;
+			}
+			metrics.tasksQueued.Sub(dropped);
 		}
 	};
 
@@ -1,9 +1,524 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define XPROJECT_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define XPROJECT_HAS_TSC 1
+#endif
+
 namespace Utils {
 
-	class Timer {
+	/// TscClock
+	/// ------------------------------------------------------------
+	/// std::chrono clock over the time stamp counter: a read is a few cycles instead of a
+	/// system call on some platforms. Calibrated once against steady_clock on first use,
+	/// which assumes an invariant TSC (any x86 CPU of the last decade). Falls back to
+	/// steady_clock where there is no TSC.
+	struct TscClock {
+		using rep = std::int64_t;
+		using period = std::nano;
+		using duration = std::chrono::nanoseconds;
+		using time_point = std::chrono::time_point<TscClock>;
+		static constexpr bool is_steady = true;
+
+		static time_point now() noexcept {
+#ifdef XPROJECT_HAS_TSC
+			const Calibration& calibration = Calibrate();
+			return time_point(duration(static_cast<rep>(static_cast<double>(__rdtsc() - calibration.baseTicks) * calibration.nanosPerTick)));
+#else
+			return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+#endif
+		}
+
+	private:
+#ifdef XPROJECT_HAS_TSC
+		struct Calibration {
+			std::uint64_t baseTicks;
+			double nanosPerTick;
+		};
+
+		static const Calibration& Calibrate() {
+			static const Calibration calibration = []() {
+				using Steady = std::chrono::steady_clock;
+				constexpr std::chrono::milliseconds kWindow{ 5 };
+
+				const Steady::time_point startTime = Steady::now();
+				const std::uint64_t startTicks = __rdtsc();
+
+				Steady::time_point endTime;
+				do {
+					endTime = Steady::now();
+				} while (endTime - startTime < kWindow);
+				const std::uint64_t endTicks = __rdtsc();
+
+				const double nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count());
+				return Calibration{ startTicks, nanos / static_cast<double>(endTicks - startTicks) };
+			}();
+			return calibration;
+		}
+#endif
+	};
+
+	// Small sequence number of the calling thread, spreads threads over sharded counters
+	inline std::size_t ThreadOrdinal() {
+		static std::atomic<std::size_t> nextOrdinal{ 0 };
+		thread_local const std::size_t ordinal = nextOrdinal.fetch_add(1, std::memory_order_relaxed);
+		return ordinal;
+	}
+
+	/// LatencySnapshot
+	/// ------------------------------------------------------------
+	/// Merged copy of a LatencyHistogram, read at leisure
+	class LatencySnapshot {
+	private:
+		friend class LatencyHistogram;
+
+		std::vector<std::uint64_t> counts;
+		std::uint64_t total = 0;
+		std::uint64_t sum = 0;
+		std::uint64_t min = 0;
+		std::uint64_t max = 0;
+
+	public:
+		std::uint64_t Count() const { return total; }
+		std::chrono::nanoseconds Min() const { return std::chrono::nanoseconds(min); }
+		std::chrono::nanoseconds Max() const { return std::chrono::nanoseconds(max); }
+		std::chrono::nanoseconds Sum() const { return std::chrono::nanoseconds(sum); }
+		std::chrono::nanoseconds Mean() const { return std::chrono::nanoseconds(total == 0 ? 0 : sum / total); }
+
+		/// Smallest recorded value that _percentile percent of the values do not exceed,
+		/// within the bucket precision. 0 when nothing was recorded.
+		std::chrono::nanoseconds Percentile(double _percentile) const;
+	};
+
+	/// LatencyHistogram
+	/// ------------------------------------------------------------
+	/// Log-linear histogram in the manner of HdrHistogram: kSubBuckets linear buckets per
+	/// power of two, so every value is kept within about 3%, from 1 ns up to kMaxValue.
+	/// Record is a relaxed atomic increment into the shard of the calling thread, threads
+	/// rarely share a shard so the counters do not bounce between cores. Snapshot merges
+	/// the shards and may run concurrently with Record.
+	class LatencyHistogram {
+	private:
+		static constexpr int kSubBits = 5;
+		static constexpr std::uint64_t kSubBuckets = std::uint64_t(1) << kSubBits;
+		static constexpr int kMaxBits = 42;
+		static constexpr std::size_t kBuckets = (kMaxBits - kSubBits + 1) * kSubBuckets;
+		static constexpr std::size_t kShards = 8;
+
+		struct alignas(64) Shard {
+			std::array<std::atomic<std::uint64_t>, kBuckets> counts{};
+			std::atomic<std::uint64_t> total{ 0 };
+			std::atomic<std::uint64_t> sum{ 0 };
+			std::atomic<std::uint64_t> min{ std::numeric_limits<std::uint64_t>::max() };
+			std::atomic<std::uint64_t> max{ 0 };
+		};
+
+		std::unique_ptr<Shard[]> shards = std::make_unique<Shard[]>(kShards);
+
+	public:
+		// About 73 minutes, larger values land in the last bucket
+		static constexpr std::uint64_t kMaxValue = (std::uint64_t(1) << kMaxBits) - 1;
+
+		LatencyHistogram() = default;
+		LatencyHistogram(const LatencyHistogram&) = delete;
+		LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+		void Record(std::uint64_t _nanos) {
+			Shard& shard = shards[ThreadOrdinal() % kShards];
+
+			shard.counts[BucketOf(_nanos)].fetch_add(1, std::memory_order_relaxed);
+			shard.total.fetch_add(1, std::memory_order_relaxed);
+			shard.sum.fetch_add(_nanos, std::memory_order_relaxed);
+
+			std::uint64_t seen = shard.min.load(std::memory_order_relaxed);
+			while (_nanos < seen && !shard.min.compare_exchange_weak(seen, _nanos, std::memory_order_relaxed)) {}
+			seen = shard.max.load(std::memory_order_relaxed);
+			while (_nanos > seen && !shard.max.compare_exchange_weak(seen, _nanos, std::memory_order_relaxed)) {}
+		}
+
+		template<typename Rep, typename Period>
+		void Record(std::chrono::duration<Rep, Period> _elapsed) {
+			const std::int64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(_elapsed).count();
+			Record(static_cast<std::uint64_t>(std::max<std::int64_t>(nanos, 0)));
+		}
+
+		LatencySnapshot Snapshot() const {
+			LatencySnapshot snapshot;
+			snapshot.counts.assign(kBuckets, 0);
+
+			std::uint64_t min = std::numeric_limits<std::uint64_t>::max();
+			for (std::size_t i = 0; i < kShards; i++) {
+				const Shard& shard = shards[i];
+				for (std::size_t bucket = 0; bucket < kBuckets; bucket++) {
+					snapshot.counts[bucket] += shard.counts[bucket].load(std::memory_order_relaxed);
+				}
+				snapshot.total += shard.total.load(std::memory_order_relaxed);
+				snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+				min = std::min(min, shard.min.load(std::memory_order_relaxed));
+				snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+			}
+			snapshot.min = snapshot.total == 0 ? 0 : min;
+
+			return snapshot;
+		}
+
+		// Not atomic as a whole, values recorded meanwhile may be partly kept
+		void Reset() {
+			for (std::size_t i = 0; i < kShards; i++) {
+				Shard& shard = shards[i];
+				for (std::atomic<std::uint64_t>& count : shard.counts) {
+					count.store(0, std::memory_order_relaxed);
+				}
+				shard.total.store(0, std::memory_order_relaxed);
+				shard.sum.store(0, std::memory_order_relaxed);
+				shard.min.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+				shard.max.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		static std::size_t BucketOf(std::uint64_t _value) {
+			_value = std::min(_value, kMaxValue);
+			if (_value < kSubBuckets) {
+				return static_cast<std::size_t>(_value);
+			}
+
+			// The top kSubBits + 1 bits pick the bucket, the rest is precision given up
+			const int shift = static_cast<int>(std::bit_width(_value)) - 1 - kSubBits;
+			return static_cast<std::size_t>((shift + 1) * kSubBuckets + ((_value >> shift) - kSubBuckets));
+		}
+
+		// Largest value that falls into _bucket
+		static std::uint64_t BucketUpperBound(std::size_t _bucket) {
+			if (_bucket < kSubBuckets) {
+				return _bucket;
+			}
+
+			const int shift = static_cast<int>(_bucket / kSubBuckets) - 1;
+			const std::uint64_t lower = (kSubBuckets + _bucket % kSubBuckets) << shift;
+			return lower + (std::uint64_t(1) << shift) - 1;
+		}
+	};
+
+	inline std::chrono::nanoseconds LatencySnapshot::Percentile(double _percentile) const {
+		if (total == 0) {
+			return std::chrono::nanoseconds(0);
+		}
+
+		const double clamped = std::clamp(_percentile, 0.0, 100.0);
+		const std::uint64_t rank = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(total))), 1);
+
+		std::uint64_t seen = 0;
+		for (std::size_t bucket = 0; bucket < counts.size(); bucket++) {
+			seen += counts[bucket];
+			if (seen >= rank) {
+				return std::chrono::nanoseconds(std::clamp(LatencyHistogram::BucketUpperBound(bucket), min, max));
+			}
+		}
+		return std::chrono::nanoseconds(max);
+	}
+
+	/// Timer
+	/// ------------------------------------------------------------
+	/// Scoped stopwatch started on construction. Given a histogram it records the elapsed
+	/// time into it when it goes out of scope, unless Cancel was called.
+	template<typename Clock>
+	class BasicTimer {
+	private:
+		typename Clock::time_point start = Clock::now();
+		LatencyHistogram* histogram = nullptr;
+
+	public:
+		BasicTimer() = default;
+		explicit BasicTimer(LatencyHistogram& _histogram) : histogram(&_histogram) {}
+		~BasicTimer() {
+			if (histogram != nullptr) {
+				histogram->Record(Elapsed());
+			}
+		}
+
+		BasicTimer(const BasicTimer&) = delete;
+		BasicTimer& operator=(const BasicTimer&) = delete;
+
+		std::chrono::nanoseconds Elapsed() const {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+		}
+
+		// Returns the time elapsed so far and starts over
+		std::chrono::nanoseconds Restart() {
+			const typename Clock::time_point now = Clock::now();
+			const std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start);
+			start = now;
+			return elapsed;
+		}
+
+		void Cancel() { histogram = nullptr; }
+	};
+
+	using Timer = BasicTimer<std::chrono::steady_clock>;
+	// Same on the time stamp counter, for spans of a few hundred nanoseconds
+	using CycleTimer = BasicTimer<TscClock>;
+
+	class TimerWheel;
+
+	/// TimerNode
+	/// ------------------------------------------------------------
+	/// Intrusive timer entry owned by the caller. Linked into a wheel slot while
+	/// scheduled, so scheduling allocates nothing and cancelling is an unlink.
+	/// Destroying a scheduled node cancels it through its wheel.
+	class TimerNode {
+	private:
+		friend class TimerWheel;
 
+		TimerNode* prev = nullptr;
+		TimerNode* next = nullptr;
+		std::uint64_t expiry = 0;
+		// Wheel the node is scheduled on, cleared after the unlink so a destructor seeing
+		// null may free the node
+		std::atomic<TimerWheel*> owner = nullptr;
+
+		std::function<void()> callback;
+
+	public:
+		TimerNode() = default;
+		explicit TimerNode(std::function<void()> _callback) : callback(std::move(_callback)) {}
+		inline ~TimerNode();
+
+		TimerNode(const TimerNode&) = delete;
+		TimerNode& operator=(const TimerNode&) = delete;
+
+		bool IsScheduled() const { return next != nullptr; }
+
+		void SetCallback(std::function<void()> _callback) { callback = std::move(_callback); }
+		const std::function<void()>& Callback() const { return callback; }
+
+	private:
+		void Unlink() {
+			if (next != nullptr) {
+				prev->next = next;
+				next->prev = prev;
+				prev = next = nullptr;
+			}
+		}
+
+		void LinkBefore(TimerNode* _sentinel) {
+			next = _sentinel;
+			prev = _sentinel->prev;
+			prev->next = this;
+			_sentinel->prev = this;
+		}
+	};
+
+	/// TimerWheel
+	/// ------------------------------------------------------------
+	/// Hierarchical timing wheel: kLevels levels of kSlots slots, each level kSlots times
+	/// coarser than the one below. Schedule and Cancel are O(1), a timer is moved down at
+	/// most kLevels - 1 times before it fires. Time is counted in ticks, the owner decides
+	/// how long a tick is. Not thread-safe; callbacks may schedule and cancel any node.
+	class TimerWheel {
+	private:
+		friend class TimerNode;
+
+		static constexpr int kSlotBits = 8;
+		static constexpr std::size_t kSlots = std::size_t(1) << kSlotBits;
+		static constexpr std::uint64_t kSlotMask = kSlots - 1;
+		static constexpr int kLevels = 4;
+
+		// Sentinels of the circular slot lists
+		std::array<std::array<TimerNode, kSlots>, kLevels> slots;
+
+		std::uint64_t currentTick = 0;
+		std::size_t count = 0;
+
+		// Lock of the owner that serializes access, taken when a scheduled node is destroyed
+		std::mutex* guard = nullptr;
+
+	public:
+		// Longest delay that does not wrap around the top level
+		static constexpr std::uint64_t kMaxDelay = (std::uint64_t(1) << (kSlotBits * kLevels)) - 1;
+
+		TimerWheel() {
+			for (auto& level : slots) {
+				for (TimerNode& sentinel : level) {
+					sentinel.prev = sentinel.next = &sentinel;
+				}
+			}
+		}
+
+		~TimerWheel() {
+			for (auto& level : slots) {
+				for (TimerNode& sentinel : level) {
+					while (sentinel.next != &sentinel) {
+						TimerNode* node = sentinel.next;
+						node->Unlink();
+						node->owner.store(nullptr, std::memory_order_release);
+					}
+					sentinel.prev = sentinel.next = nullptr;
+				}
+			}
+		}
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		// _mutex must be held around every other call once set
+		void SetGuard(std::mutex* _mutex) { guard = _mutex; }
+
+		std::uint64_t Now() const { return currentTick; }
+		std::size_t Size() const { return count; }
+		bool Empty() const { return count == 0; }
+
+		/// Fires _node after _ticks ticks (at least one), rescheduling it if it is pending
+		void Schedule(TimerNode& _node, std::uint64_t _ticks) {
+			Cancel(_node);
+
+			_node.expiry = currentTick + std::clamp<std::uint64_t>(_ticks, 1, kMaxDelay);
+			_node.owner.store(this, std::memory_order_release);
+			Insert(_node);
+			count++;
+		}
+
+		void Schedule(TimerNode& _node, std::uint64_t _ticks, std::function<void()> _callback) {
+			_node.callback = std::move(_callback);
+			Schedule(_node, _ticks);
+		}
+
+		// False if the node was not scheduled
+		bool Cancel(TimerNode& _node) {
+			if (!_node.IsScheduled()) {
+				return false;
+			}
+
+			_node.Unlink();
+			_node.owner.store(nullptr, std::memory_order_release);
+			count--;
+			return true;
+		}
+
+		/// Moves the wheel to tick _target and fires everything due up to it, in tick order.
+		/// Returns the number of fired timers.
+		std::size_t Advance(std::uint64_t _target) {
+			return Advance(_target, [](TimerNode& _node) { _node.callback(); });
+		}
+
+		/// Same, but hands every due node to _fire instead of calling its callback. _fire
+		/// must not destroy the node.
+		template<typename Fire>
+		std::size_t Advance(std::uint64_t _target, Fire&& _fire) {
+			std::size_t fired = 0;
+
+			while (currentTick < _target) {
+				if (count == 0) {
+					// Nothing to cascade, skip the idle ticks at once
+					currentTick = _target;
+					break;
+				}
+
+				currentTick++;
+				Cascade();
+
+				TimerNode& sentinel = slots[0][currentTick & kSlotMask];
+
+				// Detached first, callbacks may schedule into this very slot
+				TimerNode due;
+				Splice(sentinel, due);
+
+				while (due.next != &due) {
+					TimerNode* node = due.next;
+					node->Unlink();
+					count--;
+					fired++;
+
+					_fire(*node);
+
+					// Kept until _fire is done with the node, unless it scheduled the node again
+					if (!node->IsScheduled()) {
+						node->owner.store(nullptr, std::memory_order_release);
+					}
+				}
+				due.prev = due.next = nullptr;
+			}
+
+			return fired;
+		}
+
+	private:
+		void Insert(TimerNode& _node) {
+			const std::uint64_t delta = _node.expiry - currentTick;
+
+			int level = 0;
+			while (level < kLevels - 1 && delta >= (std::uint64_t(1) << (kSlotBits * (level + 1)))) {
+				level++;
+			}
+
+			_node.LinkBefore(&slots[level][(_node.expiry >> (kSlotBits * level)) & kSlotMask]);
+		}
+
+		// Re-inserts the timers of every higher-level slot whose range starts at the current tick
+		void Cascade() {
+			for (int level = 1; level < kLevels; level++) {
+				if ((currentTick & ((std::uint64_t(1) << (kSlotBits * level)) - 1)) != 0) {
+					break;
+				}
+
+				TimerNode& sentinel = slots[level][(currentTick >> (kSlotBits * level)) & kSlotMask];
+
+				TimerNode moved;
+				Splice(sentinel, moved);
+
+				while (moved.next != &moved) {
+					TimerNode* node = moved.next;
+					node->Unlink();
+					Insert(*node);
+				}
+				moved.prev = moved.next = nullptr;
+			}
+		}
+
+		// Moves the whole list of _from into the empty sentinel _to
+		static void Splice(TimerNode& _from, TimerNode& _to) {
+			if (_from.next == &_from) {
+				_to.prev = _to.next = &_to;
+				return;
+			}
+
+			_to.next = _from.next;
+			_to.prev = _from.prev;
+			_to.next->prev = &_to;
+			_to.prev->next = &_to;
+			_from.prev = _from.next = &_from;
+		}
 	};
-	
+
+	inline TimerNode::~TimerNode() {
+		TimerWheel* wheel = owner.load(std::memory_order_acquire);
+		if (wheel == nullptr) {
+			return;
+		}
+
+		// May race the owner firing the node, scheduled state is only read under its lock
+		if (wheel->guard != nullptr) {
+			std::lock_guard<std::mutex> lock(*wheel->guard);
+			wheel->Cancel(*this);
+		}
+		else {
+			wheel->Cancel(*this);
+		}
+	}
+
 }
\ No newline at end of file
@@ -2,8 +2,8 @@
 
 #include "xProject_pch.hpp"
 
-#define JsonMSG(key, text) JSON::parse("{\"" + std::string(key) + "\":\"" + std::string(text) + "\"}")
-#define JsonMSGDump(key, text) JSON::parse("{\"" + std::string(key) + "\":\"" + std::string(text) + "\"}").dump()
+#define JsonMSG(key, text) JSON::object({ { std::string(key), std::string(text) } })
+#define JsonMSGDump(key, text) JsonMSG(key, text).dump()
 
 #define AssertMSG(expr, text, format)  if(expr){ spdlog::error(text, format); }
 